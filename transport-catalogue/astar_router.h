@@ -0,0 +1,318 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+#include "search_scratch.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+    // Goal-directed point-to-point search. The queue is ordered by the weight from the source
+    // plus a lower bound of the remaining weight, so vertices leading away from the target
+    // are rarely settled. Two bounds are combined:
+    //   - a metric between vertices (e.g. geographic distance), scaled by the smallest
+    //     weight per metric unit among the edges, so it never overestimates;
+    //   - ALT: distances to and from a few landmarks and the triangle inequality.
+    // Both bounds are consistent, so each vertex is settled once, as in Dijkstra.
+    template <typename Weight>
+    class AStarRouter : public RouterInterface<Weight> {
+    private:
+        using Graph = DirectedWeightedGraph<Weight>;
+
+    public:
+        // Distance between two vertices satisfying the triangle inequality
+        using Metric = std::function<Weight(VertexId, VertexId)>;
+
+        explicit AStarRouter(const Graph& graph, size_t landmark_count = DEFAULT_LANDMARK_COUNT, Metric metric = {});
+
+        using RouteInfo = graph::RouteInfo<Weight>;
+
+        std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+
+        size_t GetLandmarkCount() const {
+            return landmarks_.size();
+        }
+
+        static constexpr size_t DEFAULT_LANDMARK_COUNT = 8;
+
+    private:
+        static constexpr Weight ZERO_WEIGHT{};
+        static constexpr Weight UNREACHABLE = std::numeric_limits<Weight>::infinity();
+
+        struct QueueItem {
+            // Weight from the source plus the lower bound to the target
+            Weight key;
+            Weight weight;
+            VertexId vertex;
+
+            bool operator>(const QueueItem& other) const {
+                return key > other.key;
+            }
+        };
+
+        // Buffers of a Dijkstra search and the bounds of the vertices it reaches
+        struct Scratch : SearchScratch<Weight, QueueItem> {
+            // Lower bounds of the reached vertices to the target
+            std::vector<Weight> bounds;
+
+            void Prepare(size_t vertex_count) {
+                SearchScratch<Weight, QueueItem>::Prepare(vertex_count);
+                if (bounds.size() < vertex_count) {
+                    bounds.resize(vertex_count);
+                }
+            }
+        };
+
+        // Plain Dijkstra over the whole graph, UNREACHABLE for vertices which can't be reached
+        static std::vector<Weight> ComputeDistances(const CompactGraph<Weight>& graph, VertexId from);
+
+        void SelectLandmarks(size_t landmark_count);
+        void CalibrateMetric(const Graph& graph);
+
+        // Lower bound of the weight from the vertex to the target, UNREACHABLE if the target
+        // is proven to be unreachable from the vertex
+        Weight LowerBound(VertexId vertex, VertexId to) const;
+
+        std::shared_ptr<const CompactGraph<Weight>> graph_;
+        CompactGraph<Weight> reversed_graph_;
+
+        std::vector<VertexId> landmarks_;
+        // Vertex-major: the distances of a vertex to all landmarks are adjacent
+        std::vector<Weight> from_landmarks_;
+        std::vector<Weight> to_landmarks_;
+
+        Metric metric_;
+        // Weight per metric unit, never greater than the one of any edge
+        Weight metric_scale_ = ZERO_WEIGHT;
+    };
+
+    template <typename Weight>
+    AStarRouter<Weight>::AStarRouter(const Graph& graph, size_t landmark_count, Metric metric)
+        : graph_(graph.GetCompactGraph())
+        , metric_(std::move(metric))
+    {
+        std::vector<Edge<Weight>> reversed_edges;
+        std::vector<EdgeId> edge_ids;
+        reversed_edges.reserve(graph.GetEdgeCount());
+        edge_ids.reserve(graph.GetEdgeCount());
+        for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+            const auto& edge = graph.GetEdge(edge_id);
+            if (edge.weight < ZERO_WEIGHT) {
+                throw std::domain_error("Edges' weights should be non-negative");
+            }
+            reversed_edges.push_back({edge.to, edge.from, edge.weight});
+            edge_ids.push_back(edge_id);
+        }
+        reversed_graph_ = CompactGraph<Weight>(graph.GetVertexCount(), reversed_edges, edge_ids);
+
+        SelectLandmarks(std::min(landmark_count, graph.GetVertexCount()));
+        if (metric_) {
+            CalibrateMetric(graph);
+        }
+    }
+
+    template <typename Weight>
+    std::vector<Weight> AStarRouter<Weight>::ComputeDistances(const CompactGraph<Weight>& graph, VertexId from) {
+        std::vector<Weight> distances(graph.GetVertexCount(), UNREACHABLE);
+        std::vector<std::pair<Weight, VertexId>> heap;
+        const auto cmp = std::greater<std::pair<Weight, VertexId>>{};
+        distances[from] = ZERO_WEIGHT;
+        heap.push_back({ZERO_WEIGHT, from});
+        while (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), cmp);
+            const auto [weight, vertex] = heap.back();
+            heap.pop_back();
+            if (weight > distances[vertex]) {
+                continue;
+            }
+            for (size_t arc = graph.ArcsBegin(vertex); arc < graph.ArcsEnd(vertex); ++arc) {
+                const VertexId target = graph.GetTarget(arc);
+                const Weight candidate_weight = weight + graph.GetWeight(arc);
+                if (candidate_weight < distances[target]) {
+                    distances[target] = candidate_weight;
+                    heap.push_back({candidate_weight, target});
+                    std::push_heap(heap.begin(), heap.end(), cmp);
+                }
+            }
+        }
+        return distances;
+    }
+
+    template <typename Weight>
+    void AStarRouter<Weight>::SelectLandmarks(size_t landmark_count) {
+        const size_t vertex_count = graph_->GetVertexCount();
+        if (landmark_count == 0) {
+            return;
+        }
+        // Farthest selection: every next landmark is the vertex farthest from the chosen ones,
+        // so landmarks end up on the periphery, "behind" most targets.
+        // Vertices which aren't reached by any landmark yet are the farthest of all.
+        std::vector<Weight> nearest(vertex_count, UNREACHABLE);
+        std::vector<bool> is_landmark(vertex_count, false);
+        VertexId next = 0;
+        for (VertexId vertex = 1; vertex < vertex_count; ++vertex) {
+            if (graph_->ArcsEnd(vertex) - graph_->ArcsBegin(vertex) > graph_->ArcsEnd(next) - graph_->ArcsBegin(next)) {
+                next = vertex;
+            }
+        }
+        std::vector<std::vector<Weight>> from_landmarks;
+        std::vector<std::vector<Weight>> to_landmarks;
+        while (landmarks_.size() < landmark_count) {
+            landmarks_.push_back(next);
+            is_landmark[next] = true;
+            from_landmarks.push_back(ComputeDistances(*graph_, next));
+            to_landmarks.push_back(ComputeDistances(reversed_graph_, next));
+
+            std::optional<VertexId> farthest;
+            for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+                nearest[vertex] = std::min({nearest[vertex], from_landmarks.back()[vertex], to_landmarks.back()[vertex]});
+                if (!is_landmark[vertex] && (!farthest || nearest[vertex] > nearest[*farthest])) {
+                    farthest = vertex;
+                }
+            }
+            if (!farthest) {
+                break;
+            }
+            next = *farthest;
+        }
+
+        const size_t count = landmarks_.size();
+        from_landmarks_.resize(vertex_count * count);
+        to_landmarks_.resize(vertex_count * count);
+        for (size_t landmark = 0; landmark < count; ++landmark) {
+            for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+                from_landmarks_[vertex * count + landmark] = from_landmarks[landmark][vertex];
+                to_landmarks_[vertex * count + landmark] = to_landmarks[landmark][vertex];
+            }
+        }
+    }
+
+    template <typename Weight>
+    void AStarRouter<Weight>::CalibrateMetric(const Graph& graph) {
+        // metric(v, to) * scale <= weight(v, to) holds for every edge, and by the triangle inequality
+        // it then holds for every path
+        std::optional<Weight> scale;
+        for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+            const auto& edge = graph.GetEdge(edge_id);
+            const Weight distance = metric_(edge.from, edge.to);
+            if (distance > ZERO_WEIGHT) {
+                const Weight edge_scale = edge.weight / distance;
+                if (!scale || edge_scale < *scale) {
+                    scale = edge_scale;
+                }
+            }
+        }
+        metric_scale_ = scale.value_or(ZERO_WEIGHT);
+        if (metric_scale_ == ZERO_WEIGHT) {
+            // The metric gives no bound at all, don't waste time computing it
+            metric_ = {};
+        }
+    }
+
+    template <typename Weight>
+    Weight AStarRouter<Weight>::LowerBound(VertexId vertex, VertexId to) const {
+        Weight bound = ZERO_WEIGHT;
+        const size_t count = landmarks_.size();
+        const Weight* from_vertex = from_landmarks_.data() + vertex * count;
+        const Weight* from_target = from_landmarks_.data() + to * count;
+        const Weight* to_vertex = to_landmarks_.data() + vertex * count;
+        const Weight* to_target = to_landmarks_.data() + to * count;
+        for (size_t landmark = 0; landmark < count; ++landmark) {
+            // d(L, to) <= d(L, vertex) + d(vertex, to)
+            if (from_vertex[landmark] != UNREACHABLE) {
+                if (from_target[landmark] == UNREACHABLE) {
+                    return UNREACHABLE;
+                }
+                bound = std::max(bound, from_target[landmark] - from_vertex[landmark]);
+            }
+            // d(vertex, L) <= d(vertex, to) + d(to, L)
+            if (to_target[landmark] != UNREACHABLE) {
+                if (to_vertex[landmark] == UNREACHABLE) {
+                    return UNREACHABLE;
+                }
+                bound = std::max(bound, to_vertex[landmark] - to_target[landmark]);
+            }
+        }
+        if (metric_) {
+            bound = std::max(bound, metric_(vertex, to) * metric_scale_);
+        }
+        return bound;
+    }
+
+    template <typename Weight>
+    std::optional<typename AStarRouter<Weight>::RouteInfo> AStarRouter<Weight>::BuildRoute(VertexId from,
+                                                                                           VertexId to) const {
+        const size_t vertex_count = graph_->GetVertexCount();
+        if (from >= vertex_count || to >= vertex_count) {
+            throw std::out_of_range("Vertex is out of graph");
+        }
+        const Weight from_bound = LowerBound(from, to);
+        if (from_bound == UNREACHABLE) {
+            return std::nullopt;
+        }
+        Scratch& scratch = GetThreadScratch<Scratch>();
+        scratch.Prepare(vertex_count);
+        auto& side = scratch.sides[0];
+        auto& heap = side.heap;
+        const auto cmp = std::greater<QueueItem>{};
+
+        side.stamps[from] = scratch.stamp;
+        side.weights[from] = ZERO_WEIGHT;
+        scratch.bounds[from] = from_bound;
+        heap.push_back({from_bound, ZERO_WEIGHT, from});
+
+        bool found = false;
+        while (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), cmp);
+            const QueueItem item = heap.back();
+            heap.pop_back();
+            if (item.weight > side.weights[item.vertex]) {
+                // Stale entry, the vertex has already been settled with a smaller weight
+                continue;
+            }
+            if (item.vertex == to) {
+                found = true;
+                break;
+            }
+            const size_t arcs_end = graph_->ArcsEnd(item.vertex);
+            for (size_t arc = graph_->ArcsBegin(item.vertex); arc < arcs_end; ++arc) {
+                const VertexId target = graph_->GetTarget(arc);
+                const Weight candidate_weight = item.weight + graph_->GetWeight(arc);
+                if (!scratch.IsReached(side, target)) {
+                    // The bound depends only on the vertex, so it is computed once per query
+                    side.stamps[target] = scratch.stamp;
+                    scratch.bounds[target] = LowerBound(target, to);
+                } else if (!(candidate_weight < side.weights[target])) {
+                    continue;
+                }
+                side.weights[target] = candidate_weight;
+                side.prev_edges[target] = graph_->GetEdgeId(arc);
+                side.prev_vertices[target] = item.vertex;
+                if (scratch.bounds[target] != UNREACHABLE) {
+                    heap.push_back({candidate_weight + scratch.bounds[target], candidate_weight, target});
+                    std::push_heap(heap.begin(), heap.end(), cmp);
+                }
+            }
+        }
+        if (!found) {
+            return std::nullopt;
+        }
+
+        std::vector<EdgeId> edges;
+        for (VertexId vertex = to; vertex != from; vertex = side.prev_vertices[vertex]) {
+            edges.push_back(side.prev_edges[vertex]);
+        }
+        std::reverse(edges.begin(), edges.end());
+
+        return RouteInfo{side.weights[to], std::move(edges)};
+    }
+
+}  // namespace graph
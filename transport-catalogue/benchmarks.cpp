@@ -0,0 +1,682 @@
+#include "benchmarks.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+#include "json.h"
+#include "json_builder.h"
+
+namespace benchmarks {
+    using namespace std::literals;
+
+    namespace {
+        // The parser json::Load used to be: it pulls the input from the stream one character at a time.
+        // Kept only as the baseline of the parsing benchmark.
+        namespace legacy {
+            json::Node LoadNode(std::istream& input);
+            json::Node LoadString(std::istream& input);
+
+            std::string LoadLiteral(std::istream& input) {
+                std::string s;
+                while (std::isalpha(input.peek())) {
+                    s.push_back(static_cast<char>(input.get()));
+                }
+                return s;
+            }
+
+            json::Node LoadArray(std::istream& input) {
+                json::Array result;
+
+                for (char c; input >> c && c != ']';) {
+                    if (c != ',') {
+                        input.putback(c);
+                    }
+                    result.push_back(LoadNode(input));
+                }
+                if (!input) {
+                    throw json::ParsingError("Array parsing error"s);
+                }
+                return json::Node(std::move(result));
+            }
+
+            json::Node LoadDict(std::istream& input) {
+                json::Dict dict;
+
+                for (char c; input >> c && c != '}';) {
+                    if (c == '"') {
+                        std::string key(LoadString(input).AsString());
+                        if (input >> c && c == ':') {
+                            if (dict.find(key) != dict.end()) {
+                                throw json::ParsingError("Duplicate key '"s + key + "' have been found");
+                            }
+                            dict.emplace(std::move(key), LoadNode(input));
+                        } else {
+                            throw json::ParsingError(": is expected but '"s + c + "' has been found"s);
+                        }
+                    } else if (c != ',') {
+                        throw json::ParsingError(R"(',' is expected but ')"s + c + "' has been found"s);
+                    }
+                }
+                if (!input) {
+                    throw json::ParsingError("Dictionary parsing error"s);
+                }
+                return json::Node(std::move(dict));
+            }
+
+            json::Node LoadString(std::istream& input) {
+                auto it = std::istreambuf_iterator<char>(input);
+                auto end = std::istreambuf_iterator<char>();
+                std::string s;
+                while (true) {
+                    if (it == end) {
+                        throw json::ParsingError("String parsing error");
+                    }
+                    const char ch = *it;
+                    if (ch == '"') {
+                        ++it;
+                        break;
+                    } else if (ch == '\\') {
+                        ++it;
+                        if (it == end) {
+                            throw json::ParsingError("String parsing error");
+                        }
+                        const char escaped_char = *(it);
+                        switch (escaped_char) {
+                            case 'n':
+                                s.push_back('\n');
+                                break;
+                            case 't':
+                                s.push_back('\t');
+                                break;
+                            case 'r':
+                                s.push_back('\r');
+                                break;
+                            case '"':
+                                s.push_back('"');
+                                break;
+                            case '\\':
+                                s.push_back('\\');
+                                break;
+                            default:
+                                throw json::ParsingError("Unrecognized escape sequence \\"s + escaped_char);
+                        }
+                    } else if (ch == '\n' || ch == '\r') {
+                        throw json::ParsingError("Unexpected end of line"s);
+                    } else {
+                        s.push_back(ch);
+                    }
+                    ++it;
+                }
+
+                return json::Node(std::move(s));
+            }
+
+            json::Node LoadBool(std::istream& input) {
+                const auto s = LoadLiteral(input);
+                if (s == "true"sv) {
+                    return json::Node{true};
+                } else if (s == "false"sv) {
+                    return json::Node{false};
+                } else {
+                    throw json::ParsingError("Failed to parse '"s + s + "' as bool"s);
+                }
+            }
+
+            json::Node LoadNull(std::istream& input) {
+                if (auto literal = LoadLiteral(input); literal == "null"sv) {
+                    return json::Node{nullptr};
+                } else {
+                    throw json::ParsingError("Failed to parse '"s + literal + "' as null"s);
+                }
+            }
+
+            json::Node LoadNumber(std::istream& input) {
+                std::string parsed_num;
+
+                auto read_char = [&parsed_num, &input] {
+                    parsed_num += static_cast<char>(input.get());
+                    if (!input) {
+                        throw json::ParsingError("Failed to read number from stream"s);
+                    }
+                };
+
+                auto read_digits = [&input, read_char] {
+                    if (!std::isdigit(input.peek())) {
+                        throw json::ParsingError("A digit is expected"s);
+                    }
+                    while (std::isdigit(input.peek())) {
+                        read_char();
+                    }
+                };
+
+                if (input.peek() == '-') {
+                    read_char();
+                }
+                if (input.peek() == '0') {
+                    read_char();
+                } else {
+                    read_digits();
+                }
+
+                bool is_int = true;
+                if (input.peek() == '.') {
+                    read_char();
+                    read_digits();
+                    is_int = false;
+                }
+
+                if (int ch = input.peek(); ch == 'e' || ch == 'E') {
+                    read_char();
+                    if (ch = input.peek(); ch == '+' || ch == '-') {
+                        read_char();
+                    }
+                    read_digits();
+                    is_int = false;
+                }
+
+                try {
+                    if (is_int) {
+                        try {
+                            return std::stoi(parsed_num);
+                        } catch (...) {
+                        }
+                    }
+                    return std::stod(parsed_num);
+                } catch (...) {
+                    throw json::ParsingError("Failed to convert "s + parsed_num + " to number"s);
+                }
+            }
+
+            json::Node LoadNode(std::istream& input) {
+                char c;
+                if (!(input >> c)) {
+                    throw json::ParsingError("Unexpected EOF"s);
+                }
+                switch (c) {
+                    case '[':
+                        return LoadArray(input);
+                    case '{':
+                        return LoadDict(input);
+                    case '"':
+                        return LoadString(input);
+                    case 't':
+                        [[fallthrough]];
+                    case 'f':
+                        input.putback(c);
+                        return LoadBool(input);
+                    case 'n':
+                        input.putback(c);
+                        return LoadNull(input);
+                    default:
+                        input.putback(c);
+                        return LoadNumber(input);
+                }
+            }
+
+            // The printer json::Print used to be: every value is formatted by the stream
+            struct PrintContext {
+                std::ostream& out;
+                int indent_step = 4;
+                int indent = 0;
+
+                void PrintIndent() const {
+                    for (int i = 0; i < indent; ++i) {
+                        out.put(' ');
+                    }
+                }
+
+                PrintContext Indented() const {
+                    return {out, indent_step, indent_step + indent};
+                }
+            };
+
+            void PrintNode(const json::Node& node, const PrintContext& ctx);
+
+            void PrintString(std::string_view value, std::ostream& out) {
+                out.put('"');
+                for (const char c : value) {
+                    switch (c) {
+                        case '\r':
+                            out << "\\r"sv;
+                            break;
+                        case '\n':
+                            out << "\\n"sv;
+                            break;
+                        case '"':
+                            [[fallthrough]];
+                        case '\\':
+                            out.put('\\');
+                            [[fallthrough]];
+                        default:
+                            out.put(c);
+                            break;
+                    }
+                }
+                out.put('"');
+            }
+
+            void PrintValue(std::nullptr_t, const PrintContext& ctx) {
+                ctx.out << "null"sv;
+            }
+
+            void PrintValue(bool value, const PrintContext& ctx) {
+                ctx.out << (value ? "true"sv : "false"sv);
+            }
+
+            void PrintValue(int value, const PrintContext& ctx) {
+                ctx.out << value;
+            }
+
+            void PrintValue(double value, const PrintContext& ctx) {
+                ctx.out << value;
+            }
+
+            void PrintValue(const json::String& value, const PrintContext& ctx) {
+                PrintString(value.View(), ctx.out);
+            }
+
+            void PrintValue(const json::Array& nodes, const PrintContext& ctx) {
+                std::ostream& out = ctx.out;
+                out << "[\n"sv;
+                bool first = true;
+                auto inner_ctx = ctx.Indented();
+                for (const json::Node& node : nodes) {
+                    if (first) {
+                        first = false;
+                    } else {
+                        out << ",\n"sv;
+                    }
+                    inner_ctx.PrintIndent();
+                    PrintNode(node, inner_ctx);
+                }
+                out.put('\n');
+                ctx.PrintIndent();
+                out.put(']');
+            }
+
+            void PrintValue(const json::Dict& nodes, const PrintContext& ctx) {
+                std::ostream& out = ctx.out;
+                out << "{\n"sv;
+                bool first = true;
+                auto inner_ctx = ctx.Indented();
+                for (const auto& [key, node] : nodes) {
+                    if (first) {
+                        first = false;
+                    } else {
+                        out << ",\n"sv;
+                    }
+                    inner_ctx.PrintIndent();
+                    PrintString(key.View(), ctx.out);
+                    out << ": "sv;
+                    PrintNode(node, inner_ctx);
+                }
+                out.put('\n');
+                ctx.PrintIndent();
+                out.put('}');
+            }
+
+            void PrintNode(const json::Node& node, const PrintContext& ctx) {
+                std::visit(
+                    [&ctx](const auto& value) {
+                        PrintValue(value, ctx);
+                    },
+                    node.GetValue());
+            }
+
+            // json::Dict used to be a std::map, a tree searched with string comparisons at every node.
+            // Made of a flat dict, pointing to its nodes, as the baseline of the lookup benchmark
+            using TreeDict = std::map<std::string, const json::Node*, std::less<>>;
+
+            TreeDict MakeTreeDict(const json::Dict& dict) {
+                TreeDict result;
+                for (const auto& [key, value] : dict) {
+                    result.emplace(std::string(key.View()), &value);
+                }
+                return result;
+            }
+        }  // namespace legacy
+
+        // Stops and buses shaped like real base requests, printed with indentation as our inputs are
+        std::string GenerateBaseRequests(size_t document_size) {
+            unsigned seed = 42;
+            auto next_random = [&seed]() {
+                seed = seed * 1103515245 + 12345;
+                return (seed >> 16) & 0x7fff;
+            };
+            const size_t stop_count = std::max<size_t>(10, document_size / 400);
+            auto stop_name = [](size_t index) {
+                return "Улица "s + std::to_string(index) + " \"Остановка\""s;
+            };
+
+            json::Array requests;
+            for (size_t i = 0; i < stop_count; ++i) {
+                json::Dict road_distances;
+                for (int j = 0; j < 4; ++j) {
+                    road_distances[stop_name(next_random() % stop_count)] = static_cast<int>(next_random() % 5000 + 100);
+                }
+                json::Dict stop;
+                stop.emplace("type"s, "Stop"s);
+                stop.emplace("name"s, stop_name(i));
+                stop.emplace("latitude"s, 43.5 + next_random() / 32768. / 10);
+                stop.emplace("longitude"s, 39.7 + next_random() / 32768. / 10);
+                stop.emplace("road_distances"s, std::move(road_distances));
+                requests.emplace_back(std::move(stop));
+            }
+            for (size_t i = 0; i < stop_count / 10; ++i) {
+                json::Array stops;
+                for (int j = 0; j < 20; ++j) {
+                    stops.push_back(stop_name(next_random() % stop_count));
+                }
+                json::Dict bus;
+                bus.emplace("type"s, "Bus"s);
+                bus.emplace("name"s, std::to_string(i));
+                bus.emplace("stops"s, std::move(stops));
+                bus.emplace("is_roundtrip"s, i % 2 == 0);
+                requests.emplace_back(std::move(bus));
+            }
+
+            std::ostringstream output;
+            json::Dict root;
+            root.emplace("base_requests"s, std::move(requests));
+            json::Print(json::Document{std::move(root)}, output);
+            return output.str();
+        }
+
+        // Route responses, which dominate our outputs, with a rendered map every hundred responses
+        json::Document GenerateStatResponses(size_t response_count) {
+            unsigned seed = 7;
+            auto next_random = [&seed]() {
+                seed = seed * 1103515245 + 12345;
+                return (seed >> 16) & 0x7fff;
+            };
+            std::string map;
+            for (int i = 0; i < 1000; ++i) {
+                map += "  <polyline points=\"" + std::to_string(next_random() / 7.) + ","s + std::to_string(next_random() / 3.)
+                    + "\" fill=\"none\" stroke=\"green\"/>\n"s;
+            }
+
+            json::Array responses;
+            for (size_t i = 0; i < response_count; ++i) {
+                json::Dict response;
+                response.emplace("request_id"s, static_cast<int>(i));
+                if (i % 100 == 0) {
+                    response.emplace("map"s, map);
+                    responses.emplace_back(std::move(response));
+                    continue;
+                }
+                json::Array items;
+                double total_time = 0;
+                for (int j = 0; j < 6; ++j) {
+                    json::Dict wait;
+                    wait.emplace("type"s, "Wait"s);
+                    wait.emplace("stop_name"s, "Улица "s + std::to_string(next_random()));
+                    wait.emplace("time"s, 6);
+                    items.emplace_back(std::move(wait));
+                    json::Dict ride;
+                    const double time = next_random() / 1000.;
+                    ride.emplace("type"s, "Bus"s);
+                    ride.emplace("bus"s, std::to_string(next_random() % 100));
+                    ride.emplace("span_count"s, static_cast<int>(next_random() % 10 + 1));
+                    ride.emplace("time"s, time);
+                    items.emplace_back(std::move(ride));
+                    total_time += 6 + time;
+                }
+                response.emplace("total_time"s, total_time);
+                response.emplace("items"s, std::move(items));
+                responses.emplace_back(std::move(response));
+            }
+            return json::Document{std::move(responses)};
+        }
+
+        template <typename Function>
+        double MeasureSeconds(Function function) {
+            const auto start_time = std::chrono::steady_clock::now();
+            function();
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+        }
+    }  // namespace
+
+    void JsonParsing(std::ostream& output, size_t document_size) {
+        const std::string text = GenerateBaseRequests(document_size);
+        const double megabytes = text.size() / (1024. * 1024.);
+        constexpr int RUN_COUNT = 3;
+
+        double legacy_seconds = 0;
+        double buffered_seconds = 0;
+        double arena_seconds = 0;
+        for (int run = 0; run < RUN_COUNT; ++run) {
+            json::Node legacy_root;
+            legacy_seconds += MeasureSeconds([&text, &legacy_root] {
+                std::istringstream input(text);
+                legacy_root = legacy::LoadNode(input);
+            });
+            std::optional<json::Document> document;
+            buffered_seconds += MeasureSeconds([&text, &document] {
+                std::istringstream input(text);
+                document = json::Load(input);
+            });
+            if (document->GetRoot() != legacy_root) {
+                throw std::logic_error("Parsers have built different documents");
+            }
+            std::optional<json::Document> arena_document;
+            arena_seconds += MeasureSeconds([&text, &arena_document] {
+                std::istringstream input(text);
+                arena_document = json::Load(input, json::Allocation::ARENA);
+            });
+            if (*arena_document != *document) {
+                throw std::logic_error("Parsers have built different documents");
+            }
+            // Freeing the documents is a part of their cost
+            legacy_seconds += MeasureSeconds([&legacy_root] {
+                legacy_root = json::Node{};
+            });
+            buffered_seconds += MeasureSeconds([&document] {
+                document.reset();
+            });
+            arena_seconds += MeasureSeconds([&arena_document] {
+                arena_document.reset();
+            });
+        }
+
+        output << "JSON parsing of "s << megabytes << " MB:"s << std::endl;
+        output << "    character-by-character: "s << megabytes * RUN_COUNT / legacy_seconds << " MB/s"s << std::endl;
+        output << "    buffered:               "s << megabytes * RUN_COUNT / buffered_seconds << " MB/s"s << std::endl;
+        output << "    buffered, arena:        "s << megabytes * RUN_COUNT / arena_seconds << " MB/s"s << std::endl;
+    }
+
+    void JsonPrinting(std::ostream& output, size_t response_count) {
+        const json::Document document = GenerateStatResponses(response_count);
+        constexpr int RUN_COUNT = 3;
+
+        // Milliseconds per printing of the document
+        auto measure = [&document](auto print) {
+            double seconds = 0;
+            for (int run = 0; run < RUN_COUNT; ++run) {
+                std::ostringstream stream;
+                seconds += MeasureSeconds([&print, &stream] {
+                    print(stream);
+                });
+            }
+            return seconds * 1000 / RUN_COUNT;
+        };
+        const double legacy_ms = measure([&document](std::ostream& stream) {
+            legacy::PrintNode(document.GetRoot(), legacy::PrintContext{stream});
+        });
+        const double pretty_ms = measure([&document](std::ostream& stream) {
+            json::Print(document, stream);
+        });
+        const double compact_ms = measure([&document](std::ostream& stream) {
+            json::Print(document, stream, {true});
+        });
+        const double shortest_ms = measure([&document](std::ostream& stream) {
+            json::Print(document, stream, {true, 0});
+        });
+
+        output << "JSON printing of "s << response_count << " responses:"s << std::endl;
+        output << "    stream formatting:          "s << legacy_ms << " ms"s << std::endl;
+        output << "    buffered:                   "s << pretty_ms << " ms"s << std::endl;
+        output << "    buffered, compact:          "s << compact_ms << " ms"s << std::endl;
+        output << "    compact, shortest doubles:  "s << shortest_ms << " ms"s << std::endl;
+    }
+
+    void JsonBuilding(std::ostream& output, size_t response_count) {
+        // A Route response built the way the stat request handlers build it
+        auto build_response = [](json::Builder& builder, int request_id) {
+            builder.StartDict();
+            builder.Key("request_id"s).Value(request_id);
+            builder.Key("total_time"s).Value(request_id * 1.5);
+            builder.Key("items"s).StartArray();
+            for (int i = 0; i < 6; ++i) {
+                builder.StartDict();
+                builder.Key("time"s).Value(6);
+                builder.Key("type"s).Value("Wait"s);
+                builder.Key("stop_name"s).Value("Улица "s + std::to_string(i));
+                builder.EndDict();
+                builder.StartDict();
+                builder.Key("time"s).Value(i * 1.25);
+                builder.Key("type"s).Value("Bus"s);
+                builder.Key("bus"s).Value(std::to_string(request_id % 100));
+                builder.Key("span_count"s).Value(i + 1);
+                builder.EndDict();
+            }
+            builder.EndArray();
+            builder.EndDict();
+        };
+
+        std::ostringstream node_output;
+        const double node_seconds = MeasureSeconds([&] {
+            json::ArrayPrinter printer(node_output);
+            for (size_t i = 0; i < response_count; ++i) {
+                json::Builder builder;
+                build_response(builder, static_cast<int>(i));
+                printer.Print(builder.Build());
+            }
+            printer.Finish();
+        });
+        std::ostringstream written_output;
+        const double written_seconds = MeasureSeconds([&] {
+            json::Writer writer(written_output);
+            writer.StartArray();
+            for (size_t i = 0; i < response_count; ++i) {
+                json::Builder builder(writer);
+                build_response(builder, static_cast<int>(i));
+                writer.Flush();
+            }
+            writer.EndArray();
+            writer.Flush();
+        });
+        if (json::Load(node_output.str()) != json::Load(written_output.str())) {
+            throw std::logic_error("Builders have made different documents");
+        }
+
+        output << "JSON building of "s << response_count << " Route responses:"s << std::endl;
+        output << "    nodes, then printed:        "s << node_seconds * 1000 << " ms"s << std::endl;
+        output << "    written directly:           "s << written_seconds * 1000 << " ms"s << std::endl;
+    }
+
+    void JsonDictLookup(std::ostream& output, size_t document_size) {
+        const auto document = json::Load(GenerateBaseRequests(document_size));
+        std::vector<const json::Dict*> base_requests;
+        for (const auto& request : document.GetRoot().AsMap().at("base_requests"s).AsArray()) {
+            base_requests.push_back(&request.AsMap());
+        }
+        std::vector<json::Dict> stat_requests;
+        for (size_t i = 0; i < base_requests.size(); ++i) {
+            const json::Node& name = base_requests[i]->at("name"sv);
+            if (i % 2 == 0) {
+                stat_requests.push_back({{"id", static_cast<int>(i)}, {"type", "Route"}, {"from", name}, {"to", name}});
+            } else {
+                stat_requests.push_back({{"id", static_cast<int>(i)}, {"type", base_requests[i]->at("type"sv)}, {"name", name}});
+            }
+        }
+        std::vector<legacy::TreeDict> tree_base_requests;
+        for (const json::Dict* request : base_requests) {
+            tree_base_requests.push_back(legacy::MakeTreeDict(*request));
+        }
+        std::vector<legacy::TreeDict> tree_stat_requests;
+        for (const json::Dict& request : stat_requests) {
+            tree_stat_requests.push_back(legacy::MakeTreeDict(request));
+        }
+        constexpr int RUN_COUNT = 10;
+
+        // Nanoseconds per lookup of all the requests
+        auto measure = [](const auto& requests, auto at, auto look_up_fields) {
+            size_t lookup_count = 0;
+            size_t checksum = 0;
+            const double seconds = MeasureSeconds([&] {
+                for (int run = 0; run < RUN_COUNT; ++run) {
+                    for (const auto& request : requests) {
+                        lookup_count += look_up_fields([&at, &request](std::string_view key) -> const json::Node& {
+                            return at(request, key);
+                        }, checksum);
+                    }
+                }
+            });
+            if (checksum == 0) {
+                throw std::logic_error("Lookups have found nothing");
+            }
+            return seconds * 1e9 / lookup_count;
+        };
+        // The lookups ProcessBaseRequests makes
+        auto look_up_base_fields = [](auto field, size_t& checksum) -> size_t {
+            if (field("type"sv).AsString() == "Stop"sv) {
+                checksum += field("name"sv).AsString().size();
+                checksum += field("latitude"sv).AsDouble() > 0;
+                checksum += field("longitude"sv).AsDouble() > 0;
+                checksum += field("road_distances"sv).AsMap().size();
+                return 5;
+            }
+            checksum += field("name"sv).AsString().size();
+            checksum += field("stops"sv).AsArray().size();
+            checksum += field("is_roundtrip"sv).AsBool();
+            return 4;
+        };
+        // The lookups ProcessStatRequest makes
+        auto look_up_stat_fields = [](auto field, size_t& checksum) -> size_t {
+            checksum += field("id"sv).AsInt();
+            if (field("type"sv).AsString() == "Route"sv) {
+                checksum += field("from"sv).AsString().size();
+                checksum += field("to"sv).AsString().size();
+                return 4;
+            }
+            checksum += field("name"sv).AsString().size();
+            return 3;
+        };
+        auto flat_at = [](const auto& dict, std::string_view key) -> const json::Node& {
+            if constexpr (std::is_pointer_v<std::decay_t<decltype(dict)>>) {
+                return dict->at(key);
+            } else {
+                return dict.at(key);
+            }
+        };
+        auto tree_at = [](const legacy::TreeDict& dict, std::string_view key) -> const json::Node& {
+            return *dict.find(key)->second;
+        };
+        const double flat_base_ns = measure(base_requests, flat_at, look_up_base_fields);
+        const double tree_base_ns = measure(tree_base_requests, tree_at, look_up_base_fields);
+        const double flat_stat_ns = measure(stat_requests, flat_at, look_up_stat_fields);
+        const double tree_stat_ns = measure(tree_stat_requests, tree_at, look_up_stat_fields);
+
+        output << "JSON dict lookups in "s << base_requests.size() << " base and stat requests:"s << std::endl;
+        output << "    base requests, tree:        "s << tree_base_ns << " ns"s << std::endl;
+        output << "    base requests, flat:        "s << flat_base_ns << " ns"s << std::endl;
+        output << "    stat requests, tree:        "s << tree_stat_ns << " ns"s << std::endl;
+        output << "    stat requests, flat:        "s << flat_stat_ns << " ns"s << std::endl;
+    }
+
+    void RunBenchmarks(std::ostream& output) {
+        JsonParsing(output, 32 * 1024 * 1024);
+        JsonDictLookup(output, 8 * 1024 * 1024);
+        JsonPrinting(output, 100000);
+        JsonBuilding(output, 100000);
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <iostream>
+
+// -------- Benchmarks, run by main with the --benchmark flag ----------
+
+namespace benchmarks {
+    // Parses a generated base requests document of about the given size with json::Load
+    // and with the former character-by-character parser, and prints the throughput of both
+    void JsonParsing(std::ostream& output, size_t document_size);
+
+    // Looks up the fields of generated base and stat requests the way json_reader does,
+    // in json::Dict and in a std::map it used to be, and prints the time per lookup
+    void JsonDictLookup(std::ostream& output, size_t document_size);
+
+    // Prints generated stat responses with json::Print, pretty and compact, and with
+    // the former stream-formatting printer, and prints the throughput of each
+    void JsonPrinting(std::ostream& output, size_t response_count);
+
+    // Builds generated Route responses with json::Builder as nodes which are printed afterwards,
+    // and straight into a json::Writer, and prints the time of both
+    void JsonBuilding(std::ostream& output, size_t response_count);
+
+    // This is the main benchmarking function
+    void RunBenchmarks(std::ostream& output);
+}
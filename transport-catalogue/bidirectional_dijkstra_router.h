@@ -0,0 +1,154 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+#include "search_scratch.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+    // Two Dijkstra searches grow towards each other: a forward one from the source over outgoing edges
+    // and a backward one from the target over incoming edges. Each covers a ball of about half
+    // the route weight, so far fewer vertices are settled than by a single search.
+    template <typename Weight>
+    class BidirectionalDijkstraRouter : public RouterInterface<Weight> {
+    private:
+        using Graph = DirectedWeightedGraph<Weight>;
+
+    public:
+        explicit BidirectionalDijkstraRouter(const Graph& graph);
+
+        using RouteInfo = graph::RouteInfo<Weight>;
+
+        std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+
+    private:
+        static constexpr Weight ZERO_WEIGHT{};
+        static constexpr Weight UNREACHABLE = std::numeric_limits<Weight>::infinity();
+
+        struct QueueItem {
+            Weight weight;
+            VertexId vertex;
+
+            bool operator>(const QueueItem& other) const {
+                return weight > other.weight;
+            }
+        };
+
+        // Forward and backward sides share the stamp of the query
+        using Scratch = SearchScratch<Weight, QueueItem, 2>;
+        using SearchSide = typename Scratch::Side;
+
+        static Weight TopWeight(const SearchSide& side) {
+            return side.heap.empty() ? UNREACHABLE : side.heap.front().weight;
+        }
+
+        // Settles the top vertex of the side and relaxes its arcs. Every vertex reached by both sides
+        // is a meeting candidate, the best one is kept in best_weight and meeting_vertex.
+        void Step(const CompactGraph<Weight>& graph, SearchSide& side, const SearchSide& other, uint32_t stamp,
+                  Weight& best_weight, VertexId& meeting_vertex) const;
+
+        std::shared_ptr<const CompactGraph<Weight>> forward_graph_;
+        // Arcs lead from a vertex to the sources of its incoming edges
+        CompactGraph<Weight> backward_graph_;
+    };
+
+    template <typename Weight>
+    BidirectionalDijkstraRouter<Weight>::BidirectionalDijkstraRouter(const Graph& graph)
+        : forward_graph_(graph.GetCompactGraph())
+        , backward_graph_(CompactGraph<Weight>::Reversed(graph))
+    {
+        for (size_t arc = 0; arc < forward_graph_->GetArcCount(); ++arc) {
+            if (forward_graph_->GetWeight(arc) < ZERO_WEIGHT) {
+                throw std::domain_error("Edges' weights should be non-negative");
+            }
+        }
+    }
+
+    template <typename Weight>
+    void BidirectionalDijkstraRouter<Weight>::Step(const CompactGraph<Weight>& graph, SearchSide& side,
+                                                   const SearchSide& other, uint32_t stamp,
+                                                   Weight& best_weight, VertexId& meeting_vertex) const {
+        const auto cmp = std::greater<QueueItem>{};
+        std::pop_heap(side.heap.begin(), side.heap.end(), cmp);
+        const QueueItem item = side.heap.back();
+        side.heap.pop_back();
+        if (item.weight > side.weights[item.vertex]) {
+            // Stale entry, the vertex has already been settled with a smaller weight
+            return;
+        }
+        const size_t arcs_end = graph.ArcsEnd(item.vertex);
+        for (size_t arc = graph.ArcsBegin(item.vertex); arc < arcs_end; ++arc) {
+            const VertexId target = graph.GetTarget(arc);
+            const Weight candidate_weight = item.weight + graph.GetWeight(arc);
+            if (side.stamps[target] == stamp && !(candidate_weight < side.weights[target])) {
+                continue;
+            }
+            side.stamps[target] = stamp;
+            side.weights[target] = candidate_weight;
+            side.prev_edges[target] = graph.GetEdgeId(arc);
+            side.prev_vertices[target] = item.vertex;
+            side.heap.push_back({candidate_weight, target});
+            std::push_heap(side.heap.begin(), side.heap.end(), cmp);
+            if (other.stamps[target] == stamp && candidate_weight + other.weights[target] < best_weight) {
+                best_weight = candidate_weight + other.weights[target];
+                meeting_vertex = target;
+            }
+        }
+    }
+
+    template <typename Weight>
+    std::optional<typename BidirectionalDijkstraRouter<Weight>::RouteInfo>
+    BidirectionalDijkstraRouter<Weight>::BuildRoute(VertexId from, VertexId to) const {
+        const size_t vertex_count = forward_graph_->GetVertexCount();
+        if (from >= vertex_count || to >= vertex_count) {
+            throw std::out_of_range("Vertex is out of graph");
+        }
+        Scratch& scratch = GetThreadScratch<Scratch>();
+        scratch.Prepare(vertex_count);
+        SearchSide& forward = scratch.sides[0];
+        SearchSide& backward = scratch.sides[1];
+
+        for (auto [side, vertex] : {std::pair{&forward, from}, std::pair{&backward, to}}) {
+            side->stamps[vertex] = scratch.stamp;
+            side->weights[vertex] = ZERO_WEIGHT;
+            side->heap.push_back({ZERO_WEIGHT, vertex});
+        }
+        Weight best_weight = from == to ? ZERO_WEIGHT : UNREACHABLE;
+        VertexId meeting_vertex = from;
+
+        // Any route through a vertex which isn't settled by either side is at least as heavy
+        // as the sum of the queue tops, so the best meeting found by then is the shortest route
+        while (TopWeight(forward) + TopWeight(backward) < best_weight) {
+            if (TopWeight(forward) <= TopWeight(backward)) {
+                Step(*forward_graph_, forward, backward, scratch.stamp, best_weight, meeting_vertex);
+            } else {
+                Step(backward_graph_, backward, forward, scratch.stamp, best_weight, meeting_vertex);
+            }
+        }
+        if (best_weight == UNREACHABLE) {
+            return std::nullopt;
+        }
+
+        std::vector<EdgeId> edges;
+        for (VertexId vertex = meeting_vertex; vertex != from; vertex = forward.prev_vertices[vertex]) {
+            edges.push_back(forward.prev_edges[vertex]);
+        }
+        std::reverse(edges.begin(), edges.end());
+        for (VertexId vertex = meeting_vertex; vertex != to; vertex = backward.prev_vertices[vertex]) {
+            edges.push_back(backward.prev_edges[vertex]);
+        }
+
+        return RouteInfo{best_weight, std::move(edges)};
+    }
+
+}  // namespace graph
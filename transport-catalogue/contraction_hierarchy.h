@@ -0,0 +1,427 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+#include "search_scratch.h"
+
+#include <algorithm>
+#include <functional>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+    // Contraction hierarchies: vertices are contracted one by one in the order of importance,
+    // and shortcut arcs preserve shortest distances between the remaining vertices.
+    // A query is a bidirectional search which only climbs up the hierarchy,
+    // and shortcuts of the found path are unpacked back into the original edges.
+    template <typename Weight>
+    class ContractionHierarchy : public RouterInterface<Weight> {
+    private:
+        using Graph = DirectedWeightedGraph<Weight>;
+        using ArcId = size_t;
+
+    public:
+        explicit ContractionHierarchy(const Graph& graph);
+
+        using RouteInfo = graph::RouteInfo<Weight>;
+
+        std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+
+        size_t GetShortcutCount() const;
+
+    private:
+        static constexpr ArcId NO_ARC = static_cast<ArcId>(-1);
+        static constexpr Weight ZERO_WEIGHT{};
+        // Witness searches are cut after this number of settled vertices.
+        // Missing a witness only adds a redundant shortcut, it never breaks correctness.
+        static constexpr size_t WITNESS_SETTLE_LIMIT = 500;
+        // Priority estimation only needs the shortcut count roughly, so its searches are cut much earlier
+        static constexpr size_t ESTIMATE_SETTLE_LIMIT = 30;
+
+        // Arc of the graph which is being contracted
+        struct WorkArc {
+            VertexId other;
+            Weight weight;
+            ArcId arc;
+        };
+
+        // Arc of the final search graph, always leading to a vertex of higher rank
+        struct UpwardArc {
+            VertexId other;
+            Weight weight;
+            ArcId arc;
+        };
+
+        struct Shortcut {
+            ArcId first;
+            ArcId second;
+        };
+
+        struct QueueItem {
+            Weight weight;
+            VertexId vertex;
+
+            bool operator>(const QueueItem& other) const {
+                return weight > other.weight;
+            }
+        };
+
+        // Per-thread buffers reused between queries and witness searches.
+        // Previous edges of the sides are arcs of the hierarchy rather than edges of the graph
+        using Scratch = SearchScratch<Weight, QueueItem, 2>;
+        using SearchSide = typename Scratch::Side;
+
+        void Contract(std::vector<std::vector<WorkArc>>& out_arcs, std::vector<std::vector<WorkArc>>& in_arcs);
+
+        template <typename ShortcutCallback>
+        size_t FindShortcuts(VertexId vertex,
+                             const std::vector<std::vector<WorkArc>>& out_arcs,
+                             const std::vector<std::vector<WorkArc>>& in_arcs,
+                             size_t settle_limit,
+                             ShortcutCallback&& callback) const;
+
+        static void AddOrImproveArc(std::vector<WorkArc>& arcs, VertexId other, Weight weight, ArcId arc);
+
+        void BuildSearchGraph(const std::vector<std::vector<UpwardArc>>& up_arcs,
+                              const std::vector<std::vector<UpwardArc>>& down_arcs);
+
+        void UnpackArc(ArcId arc, std::vector<EdgeId>& edges) const;
+
+        const Graph& graph_;
+        std::vector<size_t> ranks_;
+        std::vector<Shortcut> shortcuts_;
+        // Upward arcs (v -> higher ranked vertex) for the forward search
+        CompactGraph<Weight> up_graph_;
+        // Reversed downward arcs (higher ranked vertex -> v, stored at v) for the backward search.
+        // Edge ids of both graphs are arc ids: original edges first, then shortcuts.
+        CompactGraph<Weight> down_graph_;
+    };
+
+    template <typename Weight>
+    ContractionHierarchy<Weight>::ContractionHierarchy(const Graph& graph)
+        : graph_(graph)
+    {
+        const size_t vertex_count = graph.GetVertexCount();
+        std::vector<std::vector<WorkArc>> out_arcs(vertex_count);
+        std::vector<std::vector<WorkArc>> in_arcs(vertex_count);
+        for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+            const auto& edge = graph.GetEdge(edge_id);
+            if (edge.weight < ZERO_WEIGHT) {
+                throw std::domain_error("Edges' weights should be non-negative");
+            }
+            if (edge.from == edge.to) {
+                continue;
+            }
+            AddOrImproveArc(out_arcs[edge.from], edge.to, edge.weight, edge_id);
+            AddOrImproveArc(in_arcs[edge.to], edge.from, edge.weight, edge_id);
+        }
+        Contract(out_arcs, in_arcs);
+    }
+
+    template <typename Weight>
+    size_t ContractionHierarchy<Weight>::GetShortcutCount() const {
+        return shortcuts_.size();
+    }
+
+    template <typename Weight>
+    void ContractionHierarchy<Weight>::AddOrImproveArc(std::vector<WorkArc>& arcs, VertexId other, Weight weight, ArcId arc) {
+        for (WorkArc& existing : arcs) {
+            if (existing.other == other) {
+                if (weight < existing.weight) {
+                    existing.weight = weight;
+                    existing.arc = arc;
+                }
+                return;
+            }
+        }
+        arcs.push_back({other, weight, arc});
+    }
+
+    template <typename Weight>
+    template <typename ShortcutCallback>
+    size_t ContractionHierarchy<Weight>::FindShortcuts(VertexId vertex,
+                                                       const std::vector<std::vector<WorkArc>>& out_arcs,
+                                                       const std::vector<std::vector<WorkArc>>& in_arcs,
+                                                       size_t settle_limit,
+                                                       ShortcutCallback&& callback) const {
+        const auto& outgoing = out_arcs[vertex];
+        if (outgoing.empty()) {
+            return 0;
+        }
+        Weight max_out_weight = ZERO_WEIGHT;
+        for (const WorkArc& out : outgoing) {
+            max_out_weight = std::max(max_out_weight, out.weight);
+        }
+
+        Scratch& scratch = GetThreadScratch<Scratch>();
+        SearchSide& side = scratch.sides[0];
+        // The backward side isn't used by witness searches, so its stamps mark the targets
+        SearchSide& targets = scratch.sides[1];
+        const auto cmp = std::greater<QueueItem>{};
+        size_t shortcut_count = 0;
+        for (const WorkArc& in : in_arcs[vertex]) {
+            // Local search from the in-neighbour which avoids the vertex being contracted
+            scratch.Prepare(out_arcs.size());
+            size_t targets_left = 0;
+            for (const WorkArc& out : outgoing) {
+                targets.stamps[out.other] = scratch.stamp;
+                ++targets_left;
+            }
+            const Weight limit = in.weight + max_out_weight;
+            side.stamps[in.other] = scratch.stamp;
+            side.weights[in.other] = ZERO_WEIGHT;
+            side.heap.push_back({ZERO_WEIGHT, in.other});
+            size_t settled = 0;
+            while (!side.heap.empty() && settled < settle_limit && targets_left > 0) {
+                std::pop_heap(side.heap.begin(), side.heap.end(), cmp);
+                const QueueItem item = side.heap.back();
+                side.heap.pop_back();
+                if (item.weight > side.weights[item.vertex]) {
+                    continue;
+                }
+                if (limit < item.weight) {
+                    break;
+                }
+                ++settled;
+                if (targets.stamps[item.vertex] == scratch.stamp) {
+                    --targets_left;
+                }
+                for (const WorkArc& arc : out_arcs[item.vertex]) {
+                    if (arc.other == vertex) {
+                        continue;
+                    }
+                    const Weight candidate_weight = item.weight + arc.weight;
+                    if (side.stamps[arc.other] != scratch.stamp || candidate_weight < side.weights[arc.other]) {
+                        side.stamps[arc.other] = scratch.stamp;
+                        side.weights[arc.other] = candidate_weight;
+                        side.heap.push_back({candidate_weight, arc.other});
+                        std::push_heap(side.heap.begin(), side.heap.end(), cmp);
+                    }
+                }
+            }
+
+            for (const WorkArc& out : outgoing) {
+                if (out.other == in.other) {
+                    continue;
+                }
+                const Weight via_weight = in.weight + out.weight;
+                if (side.stamps[out.other] == scratch.stamp && !(via_weight < side.weights[out.other])) {
+                    continue;
+                }
+                ++shortcut_count;
+                callback(in, out, via_weight);
+            }
+        }
+        return shortcut_count;
+    }
+
+    template <typename Weight>
+    void ContractionHierarchy<Weight>::Contract(std::vector<std::vector<WorkArc>>& out_arcs,
+                                                std::vector<std::vector<WorkArc>>& in_arcs) {
+        const size_t vertex_count = out_arcs.size();
+        const size_t edge_count = graph_.GetEdgeCount();
+        std::vector<bool> contracted(vertex_count, false);
+        std::vector<int> contracted_neighbours(vertex_count, 0);
+        std::vector<std::vector<UpwardArc>> up_arcs(vertex_count);
+        std::vector<std::vector<UpwardArc>> down_arcs(vertex_count);
+        ranks_.assign(vertex_count, 0);
+
+        const auto no_op = [](const WorkArc&, const WorkArc&, Weight) {};
+        const auto priority = [&](VertexId vertex) {
+            const long long shortcuts = static_cast<long long>(FindShortcuts(vertex, out_arcs, in_arcs, ESTIMATE_SETTLE_LIMIT, no_op));
+            const long long removed = static_cast<long long>(out_arcs[vertex].size() + in_arcs[vertex].size());
+            // Edge difference keeps the graph sparse, contracted neighbours spread contraction uniformly
+            return shortcuts - removed + 2 * contracted_neighbours[vertex];
+        };
+
+        using PriorityItem = std::pair<long long, VertexId>;
+        std::priority_queue<PriorityItem, std::vector<PriorityItem>, std::greater<PriorityItem>> queue;
+        for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+            queue.push({priority(vertex), vertex});
+        }
+
+        size_t rank = 0;
+        while (!queue.empty()) {
+            const auto [old_priority, vertex] = queue.top();
+            queue.pop();
+            if (contracted[vertex]) {
+                continue;
+            }
+            // Lazy update: the priority may have grown since the vertex was queued
+            const long long new_priority = priority(vertex);
+            if (!queue.empty() && new_priority > queue.top().first) {
+                queue.push({new_priority, vertex});
+                continue;
+            }
+
+            std::vector<std::pair<VertexId, WorkArc>> new_arcs;
+            FindShortcuts(vertex, out_arcs, in_arcs, WITNESS_SETTLE_LIMIT, [&](const WorkArc& in, const WorkArc& out, Weight weight) {
+                shortcuts_.push_back({in.arc, out.arc});
+                new_arcs.push_back({in.other, WorkArc{out.other, weight, edge_count + shortcuts_.size() - 1}});
+            });
+
+            ranks_[vertex] = rank++;
+            contracted[vertex] = true;
+            for (const WorkArc& out : out_arcs[vertex]) {
+                up_arcs[vertex].push_back({out.other, out.weight, out.arc});
+                auto& reverse = in_arcs[out.other];
+                reverse.erase(std::remove_if(reverse.begin(), reverse.end(),
+                                             [vertex](const WorkArc& arc) { return arc.other == vertex; }),
+                              reverse.end());
+                ++contracted_neighbours[out.other];
+            }
+            for (const WorkArc& in : in_arcs[vertex]) {
+                down_arcs[vertex].push_back({in.other, in.weight, in.arc});
+                auto& forward = out_arcs[in.other];
+                forward.erase(std::remove_if(forward.begin(), forward.end(),
+                                             [vertex](const WorkArc& arc) { return arc.other == vertex; }),
+                              forward.end());
+                ++contracted_neighbours[in.other];
+            }
+            out_arcs[vertex].clear();
+            out_arcs[vertex].shrink_to_fit();
+            in_arcs[vertex].clear();
+            in_arcs[vertex].shrink_to_fit();
+
+            for (const auto& [from, arc] : new_arcs) {
+                AddOrImproveArc(out_arcs[from], arc.other, arc.weight, arc.arc);
+                AddOrImproveArc(in_arcs[arc.other], from, arc.weight, arc.arc);
+            }
+        }
+
+        BuildSearchGraph(up_arcs, down_arcs);
+    }
+
+    template <typename Weight>
+    void ContractionHierarchy<Weight>::BuildSearchGraph(const std::vector<std::vector<UpwardArc>>& up_arcs,
+                                                        const std::vector<std::vector<UpwardArc>>& down_arcs) {
+        const size_t vertex_count = up_arcs.size();
+        const auto freeze = [vertex_count](const std::vector<std::vector<UpwardArc>>& arcs) {
+            std::vector<Edge<Weight>> edges;
+            std::vector<EdgeId> arc_ids;
+            for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+                for (const UpwardArc& arc : arcs[vertex]) {
+                    edges.push_back({vertex, arc.other, arc.weight});
+                    arc_ids.push_back(arc.arc);
+                }
+            }
+            return CompactGraph<Weight>(vertex_count, edges, arc_ids);
+        };
+        up_graph_ = freeze(up_arcs);
+        down_graph_ = freeze(down_arcs);
+    }
+
+    template <typename Weight>
+    void ContractionHierarchy<Weight>::UnpackArc(ArcId arc, std::vector<EdgeId>& edges) const {
+        const size_t edge_count = graph_.GetEdgeCount();
+        std::vector<ArcId> stack{arc};
+        while (!stack.empty()) {
+            const ArcId current = stack.back();
+            stack.pop_back();
+            if (current < edge_count) {
+                edges.push_back(current);
+                continue;
+            }
+            const Shortcut& shortcut = shortcuts_[current - edge_count];
+            // The first half has to be unpacked first, so it goes on top of the stack
+            stack.push_back(shortcut.second);
+            stack.push_back(shortcut.first);
+        }
+    }
+
+    template <typename Weight>
+    std::optional<typename ContractionHierarchy<Weight>::RouteInfo> ContractionHierarchy<Weight>::BuildRoute(
+        VertexId from, VertexId to) const {
+        const size_t vertex_count = ranks_.size();
+        if (from >= vertex_count || to >= vertex_count) {
+            throw std::out_of_range("Vertex is out of graph");
+        }
+        if (from == to) {
+            return RouteInfo{ZERO_WEIGHT, {}};
+        }
+
+        Scratch& scratch = GetThreadScratch<Scratch>();
+        scratch.Prepare(vertex_count);
+        SearchSide& forward = scratch.sides[0];
+        SearchSide& backward = scratch.sides[1];
+        const auto cmp = std::greater<QueueItem>{};
+
+        const auto start = [&scratch, &cmp](SearchSide& side, VertexId vertex) {
+            side.stamps[vertex] = scratch.stamp;
+            side.weights[vertex] = ZERO_WEIGHT;
+            side.prev_edges[vertex] = NO_ARC;
+            side.heap.push_back({ZERO_WEIGHT, vertex});
+        };
+        start(forward, from);
+        start(backward, to);
+
+        std::optional<Weight> best_weight;
+        VertexId meeting_vertex = from;
+
+        // Settles one vertex of the side and relaxes its upward arcs
+        const auto step = [&](SearchSide& side, const SearchSide& other_side, const CompactGraph<Weight>& graph) {
+            std::pop_heap(side.heap.begin(), side.heap.end(), cmp);
+            const QueueItem item = side.heap.back();
+            side.heap.pop_back();
+            if (item.weight > side.weights[item.vertex]) {
+                return;
+            }
+            if (other_side.stamps[item.vertex] == scratch.stamp) {
+                const Weight candidate_weight = item.weight + other_side.weights[item.vertex];
+                if (!best_weight || candidate_weight < *best_weight) {
+                    best_weight = candidate_weight;
+                    meeting_vertex = item.vertex;
+                }
+            }
+            const size_t arcs_end = graph.ArcsEnd(item.vertex);
+            for (size_t arc = graph.ArcsBegin(item.vertex); arc < arcs_end; ++arc) {
+                const VertexId target = graph.GetTarget(arc);
+                const Weight candidate_weight = item.weight + graph.GetWeight(arc);
+                if (side.stamps[target] != scratch.stamp || candidate_weight < side.weights[target]) {
+                    side.stamps[target] = scratch.stamp;
+                    side.weights[target] = candidate_weight;
+                    side.prev_edges[target] = graph.GetEdgeId(arc);
+                    side.prev_vertices[target] = item.vertex;
+                    side.heap.push_back({candidate_weight, target});
+                    std::push_heap(side.heap.begin(), side.heap.end(), cmp);
+                }
+            }
+        };
+        // A side is finished once its smallest key can't improve the best meeting found so far
+        const auto is_active = [&best_weight](const SearchSide& side) {
+            return !side.heap.empty() && (!best_weight || side.heap.front().weight < *best_weight);
+        };
+
+        while (is_active(forward) || is_active(backward)) {
+            if (is_active(forward)) {
+                step(forward, backward, up_graph_);
+            }
+            if (is_active(backward)) {
+                step(backward, forward, down_graph_);
+            }
+        }
+        if (!best_weight) {
+            return std::nullopt;
+        }
+
+        std::vector<ArcId> forward_arcs;
+        for (VertexId vertex = meeting_vertex; vertex != from; vertex = forward.prev_vertices[vertex]) {
+            forward_arcs.push_back(forward.prev_edges[vertex]);
+        }
+        std::reverse(forward_arcs.begin(), forward_arcs.end());
+        for (VertexId vertex = meeting_vertex; vertex != to; vertex = backward.prev_vertices[vertex]) {
+            forward_arcs.push_back(backward.prev_edges[vertex]);
+        }
+
+        std::vector<EdgeId> edges;
+        for (const ArcId arc : forward_arcs) {
+            UnpackArc(arc, edges);
+        }
+        return RouteInfo{*best_weight, std::move(edges)};
+    }
+
+}  // namespace graph
@@ -0,0 +1,168 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+#include "search_scratch.h"
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+    // Answers every query with a single-source search instead of precomputing all pairs,
+    // so construction is O(E) and memory is linear in the graph size.
+    template <typename Weight>
+    class DijkstraRouter : public RouterInterface<Weight> {
+    private:
+        using Graph = DirectedWeightedGraph<Weight>;
+
+    public:
+        explicit DijkstraRouter(const Graph& graph);
+
+        using RouteInfo = graph::RouteInfo<Weight>;
+
+        std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+
+        // Grows one search tree from the vertex until all targets are settled
+        std::vector<std::optional<Weight>> ComputeRouteWeights(VertexId from,
+                                                               const std::vector<VertexId>& targets) const override;
+
+    private:
+        static constexpr Weight ZERO_WEIGHT{};
+
+        struct QueueItem {
+            Weight weight;
+            VertexId vertex;
+
+            bool operator>(const QueueItem& other) const {
+                return weight > other.weight;
+            }
+        };
+
+        using Scratch = SearchScratch<Weight, QueueItem>;
+
+        // Runs the search from the vertex until should_stop returns true for a settled vertex
+        // or all reachable vertices are settled. Returns whether the search was stopped.
+        template <typename StopPredicate>
+        bool Search(Scratch& scratch, VertexId from, StopPredicate&& should_stop) const;
+
+        std::shared_ptr<const CompactGraph<Weight>> graph_;
+    };
+
+    template <typename Weight>
+    DijkstraRouter<Weight>::DijkstraRouter(const Graph& graph)
+        : graph_(graph.GetCompactGraph())
+    {
+        for (size_t arc = 0; arc < graph_->GetArcCount(); ++arc) {
+            if (graph_->GetWeight(arc) < ZERO_WEIGHT) {
+                throw std::domain_error("Edges' weights should be non-negative");
+            }
+        }
+    }
+
+    template <typename Weight>
+    template <typename StopPredicate>
+    bool DijkstraRouter<Weight>::Search(Scratch& scratch, VertexId from, StopPredicate&& should_stop) const {
+        const size_t vertex_count = graph_->GetVertexCount();
+        if (from >= vertex_count) {
+            throw std::out_of_range("Vertex is out of graph");
+        }
+        scratch.Prepare(vertex_count);
+        auto& side = scratch.sides[0];
+        auto& heap = side.heap;
+        const auto cmp = std::greater<QueueItem>{};
+
+        side.stamps[from] = scratch.stamp;
+        side.weights[from] = ZERO_WEIGHT;
+        heap.push_back({ZERO_WEIGHT, from});
+
+        while (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), cmp);
+            const QueueItem item = heap.back();
+            heap.pop_back();
+            if (item.weight > side.weights[item.vertex]) {
+                // Stale entry, the vertex has already been settled with a smaller weight
+                continue;
+            }
+            if (should_stop(item.vertex)) {
+                return true;
+            }
+            const size_t arcs_end = graph_->ArcsEnd(item.vertex);
+            for (size_t arc = graph_->ArcsBegin(item.vertex); arc < arcs_end; ++arc) {
+                const VertexId target = graph_->GetTarget(arc);
+                const Weight candidate_weight = item.weight + graph_->GetWeight(arc);
+                if (!scratch.IsReached(side, target) || candidate_weight < side.weights[target]) {
+                    side.stamps[target] = scratch.stamp;
+                    side.weights[target] = candidate_weight;
+                    side.prev_edges[target] = graph_->GetEdgeId(arc);
+                    side.prev_vertices[target] = item.vertex;
+                    heap.push_back({candidate_weight, target});
+                    std::push_heap(heap.begin(), heap.end(), cmp);
+                }
+            }
+        }
+        return false;
+    }
+
+    template <typename Weight>
+    std::optional<typename DijkstraRouter<Weight>::RouteInfo> DijkstraRouter<Weight>::BuildRoute(VertexId from,
+                                                                                                 VertexId to) const {
+        if (to >= graph_->GetVertexCount()) {
+            throw std::out_of_range("Vertex is out of graph");
+        }
+        Scratch& scratch = GetThreadScratch<Scratch>();
+        if (!Search(scratch, from, [to](VertexId vertex) { return vertex == to; })) {
+            return std::nullopt;
+        }
+        const auto& side = scratch.sides[0];
+
+        std::vector<EdgeId> edges;
+        for (VertexId vertex = to; vertex != from; vertex = side.prev_vertices[vertex]) {
+            edges.push_back(side.prev_edges[vertex]);
+        }
+        std::reverse(edges.begin(), edges.end());
+
+        return RouteInfo{side.weights[to], std::move(edges)};
+    }
+
+    template <typename Weight>
+    std::vector<std::optional<Weight>> DijkstraRouter<Weight>::ComputeRouteWeights(
+        VertexId from, const std::vector<VertexId>& targets) const {
+        const size_t vertex_count = graph_->GetVertexCount();
+        for (const VertexId to : targets) {
+            if (to >= vertex_count) {
+                throw std::out_of_range("Vertex is out of graph");
+            }
+        }
+        Scratch& scratch = GetThreadScratch<Scratch>();
+        // Targets are counted by a bitmap, so repeated targets are counted once
+        std::vector<bool> is_target(vertex_count, false);
+        size_t targets_left = 0;
+        for (const VertexId to : targets) {
+            if (!is_target[to]) {
+                is_target[to] = true;
+                ++targets_left;
+            }
+        }
+        if (targets_left > 0) {
+            Search(scratch, from, [&is_target, &targets_left](VertexId vertex) {
+                return is_target[vertex] && --targets_left == 0;
+            });
+        }
+
+        const auto& side = scratch.sides[0];
+
+        std::vector<std::optional<Weight>> weights;
+        weights.reserve(targets.size());
+        for (const VertexId to : targets) {
+            weights.push_back(scratch.IsReached(side, to) ? std::optional<Weight>(side.weights[to]) : std::nullopt);
+        }
+        return weights;
+    }
+
+}  // namespace graph
@@ -2,7 +2,12 @@
 
 #include "ranges.h"
 
+#include <cstdint>
 #include <cstdlib>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <utility>
 #include <vector>
 
 namespace graph {
@@ -17,6 +22,9 @@ namespace graph {
         Weight weight;
     };
 
+    template <typename Weight>
+    class CompactGraph;
+
     template <typename Weight>
     class DirectedWeightedGraph {
     private:
@@ -26,16 +34,29 @@ namespace graph {
     public:
         DirectedWeightedGraph() = default;
         explicit DirectedWeightedGraph(size_t vertex_count);
+        VertexId AddVertex();
         EdgeId AddEdge(const Edge<Weight>& edge);
 
         size_t GetVertexCount() const;
         size_t GetEdgeCount() const;
         const Edge<Weight>& GetEdge(EdgeId edge_id) const;
+        // Available until the graph is frozen
         IncidentEdgesRange GetIncidentEdges(VertexId vertex) const;
 
+        // Lays the graph out compactly once it is complete and releases the incidence lists,
+        // so that routing engines share one layout instead of keeping copies of the graph.
+        // Vertices and edges can't be added to a frozen graph
+        void Freeze();
+        bool IsFrozen() const;
+        // The shared layout of a frozen graph, a copy laid out on every call otherwise
+        std::shared_ptr<const CompactGraph<Weight>> GetCompactGraph() const;
+
     private:
+        void CheckNotFrozen() const;
+
         std::vector<Edge<Weight>> edges_;
         std::vector<IncidenceList> incidence_lists_;
+        std::shared_ptr<const CompactGraph<Weight>> compact_graph_;
     };
 
     template <typename Weight>
@@ -43,8 +64,16 @@ namespace graph {
         : incidence_lists_(vertex_count) {
     }
 
+    template <typename Weight>
+    VertexId DirectedWeightedGraph<Weight>::AddVertex() {
+        CheckNotFrozen();
+        incidence_lists_.emplace_back();
+        return incidence_lists_.size() - 1;
+    }
+
     template <typename Weight>
     EdgeId DirectedWeightedGraph<Weight>::AddEdge(const Edge<Weight>& edge) {
+        CheckNotFrozen();
         edges_.push_back(edge);
         const EdgeId id = edges_.size() - 1;
         incidence_lists_.at(edge.from).push_back(id);
@@ -53,7 +82,7 @@ namespace graph {
 
     template <typename Weight>
     size_t DirectedWeightedGraph<Weight>::GetVertexCount() const {
-        return incidence_lists_.size();
+        return compact_graph_ ? compact_graph_->GetVertexCount() : incidence_lists_.size();
     }
 
     template <typename Weight>
@@ -69,6 +98,167 @@ namespace graph {
     template <typename Weight>
     typename DirectedWeightedGraph<Weight>::IncidentEdgesRange
     DirectedWeightedGraph<Weight>::GetIncidentEdges(VertexId vertex) const {
+        if (compact_graph_) {
+            throw std::logic_error("Incidence lists of a frozen graph are released");
+        }
         return ranges::AsRange(incidence_lists_.at(vertex));
     }
+
+    template <typename Weight>
+    void DirectedWeightedGraph<Weight>::Freeze() {
+        if (compact_graph_) {
+            return;
+        }
+        // The lists are released first, so that they never take memory along with the layout
+        const size_t vertex_count = incidence_lists_.size();
+        incidence_lists_.clear();
+        incidence_lists_.shrink_to_fit();
+        edges_.shrink_to_fit();
+        compact_graph_ = std::make_shared<const CompactGraph<Weight>>(vertex_count, edges_);
+    }
+
+    template <typename Weight>
+    bool DirectedWeightedGraph<Weight>::IsFrozen() const {
+        return compact_graph_ != nullptr;
+    }
+
+    template <typename Weight>
+    std::shared_ptr<const CompactGraph<Weight>> DirectedWeightedGraph<Weight>::GetCompactGraph() const {
+        if (compact_graph_) {
+            return compact_graph_;
+        }
+        return std::make_shared<const CompactGraph<Weight>>(*this);
+    }
+
+    template <typename Weight>
+    void DirectedWeightedGraph<Weight>::CheckNotFrozen() const {
+        if (compact_graph_) {
+            throw std::logic_error("Frozen graph can't be changed");
+        }
+    }
+
+    // Frozen compressed-sparse-row copy of a graph for routing engines.
+    // Arcs of a vertex are stored contiguously in parallel arrays, so relaxation loops
+    // scan memory linearly instead of jumping between incidence lists and edges.
+    template <typename Weight>
+    class CompactGraph {
+    public:
+        using Index = uint32_t;
+
+        CompactGraph() = default;
+        explicit CompactGraph(const DirectedWeightedGraph<Weight>& graph);
+        // Ids of the edges are their positions
+        CompactGraph(size_t vertex_count, const std::vector<Edge<Weight>>& edges);
+        CompactGraph(size_t vertex_count, const std::vector<Edge<Weight>>& edges, const std::vector<EdgeId>& edge_ids);
+
+        // Arcs lead from the target of every edge of the graph to its source, for searches towards a vertex.
+        // Laid out straight from the edges, so the graph needs no lists of incoming edges
+        static CompactGraph Reversed(const DirectedWeightedGraph<Weight>& graph);
+
+        size_t GetVertexCount() const {
+            return offsets_.size() - 1;
+        }
+
+        size_t GetArcCount() const {
+            return targets_.size();
+        }
+
+        // Arcs of the vertex are [ArcsBegin(vertex), ArcsEnd(vertex))
+        size_t ArcsBegin(VertexId vertex) const {
+            return offsets_[vertex];
+        }
+
+        size_t ArcsEnd(VertexId vertex) const {
+            return offsets_[vertex + 1];
+        }
+
+        VertexId GetTarget(size_t arc) const {
+            return targets_[arc];
+        }
+
+        Weight GetWeight(size_t arc) const {
+            return weights_[arc];
+        }
+
+        // Id of the edge in the original graph, needed to reconstruct routes
+        EdgeId GetEdgeId(size_t arc) const {
+            return edge_ids_[arc];
+        }
+
+    private:
+        // get_edge(i) is the i-th edge, or a reference to it, and its id in the original graph
+        template <typename GetEdge>
+        void Build(size_t vertex_count, size_t edge_count, GetEdge get_edge);
+
+        std::vector<Index> offsets_ = {0};
+        std::vector<Index> targets_;
+        std::vector<Weight> weights_;
+        std::vector<Index> edge_ids_;
+    };
+
+    template <typename Weight>
+    CompactGraph<Weight>::CompactGraph(const DirectedWeightedGraph<Weight>& graph) {
+        // Edges are read in place, the graph may be too large for a copy
+        Build(graph.GetVertexCount(), graph.GetEdgeCount(), [&graph](size_t i) {
+            return std::pair<const Edge<Weight>&, EdgeId>(graph.GetEdge(i), i);
+        });
+    }
+
+    template <typename Weight>
+    CompactGraph<Weight>::CompactGraph(size_t vertex_count, const std::vector<Edge<Weight>>& edges) {
+        Build(vertex_count, edges.size(), [&edges](size_t i) {
+            return std::pair<const Edge<Weight>&, EdgeId>(edges[i], i);
+        });
+    }
+
+    template <typename Weight>
+    CompactGraph<Weight>::CompactGraph(size_t vertex_count,
+                                       const std::vector<Edge<Weight>>& edges,
+                                       const std::vector<EdgeId>& edge_ids) {
+        Build(vertex_count, edges.size(), [&edges, &edge_ids](size_t i) {
+            return std::pair<const Edge<Weight>&, EdgeId>(edges[i], edge_ids[i]);
+        });
+    }
+
+    template <typename Weight>
+    CompactGraph<Weight> CompactGraph<Weight>::Reversed(const DirectedWeightedGraph<Weight>& graph) {
+        CompactGraph reversed;
+        reversed.Build(graph.GetVertexCount(), graph.GetEdgeCount(), [&graph](size_t i) {
+            const Edge<Weight>& edge = graph.GetEdge(i);
+            return std::pair<Edge<Weight>, EdgeId>({edge.to, edge.from, edge.weight}, i);
+        });
+        return reversed;
+    }
+
+    template <typename Weight>
+    template <typename GetEdge>
+    void CompactGraph<Weight>::Build(size_t vertex_count, size_t edge_count, GetEdge get_edge) {
+        constexpr size_t max_index = std::numeric_limits<Index>::max();
+        if (vertex_count >= max_index || edge_count >= max_index) {
+            throw std::length_error("Graph is too large for compact layout");
+        }
+        offsets_.assign(vertex_count + 1, 0);
+        for (size_t i = 0; i < edge_count; ++i) {
+            ++offsets_[get_edge(i).first.from + 1];
+        }
+        for (size_t vertex = 0; vertex < vertex_count; ++vertex) {
+            offsets_[vertex + 1] += offsets_[vertex];
+        }
+
+        // Counting sort by the source vertex keeps the original order of edges within a vertex
+        targets_.resize(edge_count);
+        weights_.resize(edge_count);
+        edge_ids_.resize(edge_count);
+        std::vector<Index> positions(offsets_.begin(), offsets_.end() - 1);
+        for (size_t i = 0; i < edge_count; ++i) {
+            const auto [edge, edge_id] = get_edge(i);
+            if (edge_id >= max_index) {
+                throw std::length_error("Edge id is too large for compact layout");
+            }
+            const Index position = positions[edge.from]++;
+            targets_[position] = static_cast<Index>(edge.to);
+            weights_[position] = edge.weight;
+            edge_ids_[position] = static_cast<Index>(edge_id);
+        }
+    }
 }  // namespace graph
@@ -1,343 +1,934 @@
 #include "json.h"
 
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
 #include <iterator>
+#include <limits>
+#include <new>
+#include <utility>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace json {
     using namespace std::literals;
 
     namespace {
-        Node LoadNode(std::istream& input);
-        Node LoadString(std::istream& input);
+        // Input is read in blocks of this size instead of one character at a time
+        constexpr size_t READ_BLOCK_SIZE = 1 << 20;
 
-        std::string LoadLiteral(std::istream& input) {
-            std::string s;
-            while (std::isalpha(input.peek())) {
-                s.push_back(static_cast<char>(input.get()));
+        std::string ReadAll(std::istream& input) {
+            std::string text;
+            while (input) {
+                const size_t old_size = text.size();
+                text.resize(old_size + READ_BLOCK_SIZE);
+                input.read(text.data() + old_size, READ_BLOCK_SIZE);
+                text.resize(old_size + static_cast<size_t>(input.gcount()));
             }
-            return s;
+            return text;
         }
 
-        Node LoadArray(std::istream& input) {
-            std::vector<Node> result;
+        bool IsSpace(char c) {
+            return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+        }
 
-            for (char c; input >> c && c != ']';) {
-                if (c != ',') {
-                    input.putback(c);
+        bool IsDigit(char c) {
+            return c >= '0' && c <= '9';
+        }
+
+        bool IsAlpha(char c) {
+            return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+        }
+
+        // Returns the first character which isn't a space, or end.
+        // Indented documents have long runs of spaces, so they are skipped 16 bytes at a time.
+        const char* SkipSpaces(const char* pos, const char* end) {
+#ifdef __SSE2__
+            const __m128i space = _mm_set1_epi8(' ');
+            const __m128i new_line = _mm_set1_epi8('\n');
+            const __m128i carriage_return = _mm_set1_epi8('\r');
+            const __m128i tab = _mm_set1_epi8('\t');
+            while (end - pos >= 16 && IsSpace(*pos)) {
+                const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+                const __m128i is_space = _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, new_line)),
+                    _mm_or_si128(_mm_cmpeq_epi8(chunk, carriage_return), _mm_cmpeq_epi8(chunk, tab)));
+                const unsigned mask = ~static_cast<unsigned>(_mm_movemask_epi8(is_space)) & 0xFFFF;
+                if (mask != 0) {
+                    pos += __builtin_ctz(mask);
+                    break;
                 }
-                result.push_back(LoadNode(input));
+                pos += 16;
             }
-            if (!input) {
-                throw ParsingError("Array parsing error"s);
+#endif
+            while (pos != end && IsSpace(*pos)) {
+                ++pos;
             }
-            return Node(std::move(result));
+            return pos;
         }
 
-        Node LoadDict(std::istream& input) {
-            Dict dict;
+        // Returns the first character which ends a plain run of a string: a quote, a backslash
+        // or a line break, or end
+        const char* FindStringSpecial(const char* pos, const char* end) {
+#ifdef __SSE2__
+            const __m128i quote = _mm_set1_epi8('"');
+            const __m128i backslash = _mm_set1_epi8('\\');
+            const __m128i new_line = _mm_set1_epi8('\n');
+            const __m128i carriage_return = _mm_set1_epi8('\r');
+            while (end - pos >= 16) {
+                const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+                const __m128i is_special = _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+                    _mm_or_si128(_mm_cmpeq_epi8(chunk, new_line), _mm_cmpeq_epi8(chunk, carriage_return)));
+                const unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(is_special));
+                if (mask != 0) {
+                    return pos + __builtin_ctz(mask);
+                }
+                pos += 16;
+            }
+#endif
+            while (pos != end && *pos != '"' && *pos != '\\' && *pos != '\n' && *pos != '\r') {
+                ++pos;
+            }
+            return pos;
+        }
 
-            for (char c; input >> c && c != '}';) {
-                if (c == '"') {
-                    std::string key = LoadString(input).AsString();
-                    if (input >> c && c == ':') {
-                        if (dict.find(key) != dict.end()) {
-                            throw ParsingError("Duplicate key '"s + key + "' have been found");
-                        }
-                        dict.emplace(std::move(key), LoadNode(input));
-                    } else {
-                        throw ParsingError(": is expected but '"s + c + "' has been found"s);
-                    }
-                } else if (c != ',') {
+        void AppendUtf8(std::string& s, uint32_t code_point) {
+            if (code_point < 0x80) {
+                s.push_back(static_cast<char>(code_point));
+            } else if (code_point < 0x800) {
+                s.push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+                s.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+            } else if (code_point < 0x10000) {
+                s.push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+                s.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+                s.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+            } else {
+                s.push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+                s.push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+                s.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+                s.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+            }
+        }
+    }  // namespace
+
+    // Recursive descent parser over a text which is entirely in memory.
+    // If strings are borrowed, the text has to outlive the document.
+    class Parser {
+    public:
+        // Containers are allocated from the arena when it is given, and so are strings which can't
+        // be borrowed from the text
+        Parser(std::string_view text, bool borrow_strings, std::pmr::memory_resource* arena = nullptr)
+            : pos_(text.data())
+            , end_(text.data() + text.size())
+            , borrow_strings_(borrow_strings)
+            , arena_(arena)
+            , resource_(arena != nullptr ? arena : std::pmr::get_default_resource()) {
+        }
+
+        Node LoadDocument() {
+            SkipWhitespace();
+            return LoadNode();
+        }
+
+        // Lets the parser continue over another part of a text, used by the pull parser
+        // which keeps only a window of the text in memory
+        void Reset(const char* pos, const char* end) {
+            pos_ = pos;
+            end_ = end;
+        }
+
+        const char* GetPosition() const {
+            return pos_;
+        }
+
+        // Parses a value which starts right at the current position
+        Node LoadNode() {
+            if (pos_ == end_) {
+                throw ParsingError("Unexpected EOF"s);
+            }
+            switch (*pos_) {
+                case '[':
+                    ++pos_;
+                    return LoadArray();
+                case '{':
+                    ++pos_;
+                    return LoadDict();
+                case '"':
+                    ++pos_;
+                    return Node(LoadString());
+                case 't':
+                    [[fallthrough]];
+                case 'f':
+                    return LoadBool();
+                case 'n':
+                    return LoadNull();
+                default:
+                    return LoadNumber();
+            }
+        }
+
+    private:
+        void SkipWhitespace() {
+            pos_ = SkipSpaces(pos_, end_);
+        }
+
+        Node LoadArray() {
+            Array result(resource_);
+            SkipWhitespace();
+            if (pos_ != end_ && *pos_ == ']') {
+                ++pos_;
+                return Node(std::move(result));
+            }
+            // Elements are collected on a stack shared by all arrays of the document and moved
+            // into an array of the exact size, so an arena doesn't keep the outgrown buffers
+            const size_t stack_begin = array_stack_.size();
+            while (true) {
+                array_stack_.push_back(LoadNode());
+                SkipWhitespace();
+                if (pos_ == end_) {
+                    throw ParsingError("Array parsing error"s);
+                }
+                const char c = *pos_++;
+                if (c == ']') {
+                    break;
+                }
+                if (c != ',') {
                     throw ParsingError(R"(',' is expected but ')"s + c + "' has been found"s);
                 }
+                SkipWhitespace();
             }
-            if (!input) {
-                throw ParsingError("Dictionary parsing error"s);
+            const auto elements_begin = array_stack_.begin() + static_cast<std::ptrdiff_t>(stack_begin);
+            result.reserve(array_stack_.size() - stack_begin);
+            std::move(elements_begin, array_stack_.end(), std::back_inserter(result));
+            array_stack_.erase(elements_begin, array_stack_.end());
+            return Node(std::move(result));
+        }
+
+        Node LoadDict() {
+            SkipWhitespace();
+            if (pos_ != end_ && *pos_ == '}') {
+                ++pos_;
+                return Node(Dict(resource_));
             }
+            // Items are collected on a stack like array elements, and the dict is made of them at once
+            const size_t stack_begin = dict_stack_.size();
+            while (true) {
+                if (pos_ == end_) {
+                    throw ParsingError("Dictionary parsing error"s);
+                }
+                if (*pos_ != '"') {
+                    throw ParsingError(R"('"' is expected but ')"s + *pos_ + "' has been found"s);
+                }
+                ++pos_;
+                String key = LoadKey();
+                SkipWhitespace();
+                if (pos_ == end_ || *pos_ != ':') {
+                    throw ParsingError(": is expected after key '"s + std::string(key.View()) + "'"s);
+                }
+                ++pos_;
+                SkipWhitespace();
+                dict_stack_.emplace_back(std::move(key), LoadNode());
+                SkipWhitespace();
+                if (pos_ == end_) {
+                    throw ParsingError("Dictionary parsing error"s);
+                }
+                const char c = *pos_++;
+                if (c == '}') {
+                    break;
+                }
+                if (c != ',') {
+                    throw ParsingError(R"(',' is expected but ')"s + c + "' has been found"s);
+                }
+                SkipWhitespace();
+            }
+            const auto items_begin = dict_stack_.begin() + static_cast<std::ptrdiff_t>(stack_begin);
+            auto key_less = [](const Dict::value_type& lhs, const Dict::value_type& rhs) {
+                return lhs.first.View() < rhs.first.View();
+            };
+            // Duplicate keys are an error, so the sort needn't be stable and allocate a buffer
+            if (!std::is_sorted(items_begin, dict_stack_.end(), key_less)) {
+                std::sort(items_begin, dict_stack_.end(), key_less);
+            }
+            const auto duplicate = std::adjacent_find(items_begin, dict_stack_.end(), [](const auto& lhs, const auto& rhs) {
+                return lhs.first == rhs.first;
+            });
+            if (duplicate != dict_stack_.end()) {
+                throw ParsingError("Duplicate key '"s + std::string(duplicate->first.View()) + "' have been found");
+            }
+            Dict dict(std::make_move_iterator(items_begin), std::make_move_iterator(dict_stack_.end()), resource_);
+            dict_stack_.erase(items_begin, dict_stack_.end());
             return Node(std::move(dict));
         }
 
-        Node LoadString(std::istream& input) {
-            auto it = std::istreambuf_iterator<char>(input);
-            auto end = std::istreambuf_iterator<char>();
-            std::string s;
+    public:
+        // Parses the rest of a string after the opening quote
+        String LoadString() {
+            if (borrow_strings_) {
+                // Only strings with escape sequences have to be unescaped into a copy
+                const char* special = FindStringSpecial(pos_, end_);
+                if (special != end_ && *special == '"') {
+                    const std::string_view value(pos_, static_cast<size_t>(special - pos_));
+                    pos_ = special + 1;
+                    return String::Borrow(value);
+                }
+            }
+            return MakeString(UnescapeString());
+        }
+
+    private:
+        // Short keys are kept inline, as dicts expect them. Longer ones are borrowed, copied into
+        // the arena or owned as other strings
+        String LoadKey() {
+            const char* special = FindStringSpecial(pos_, end_);
+            const bool is_plain = special != end_ && *special == '"';
+            std::string_view value;
+            if (is_plain) {
+                value = {pos_, static_cast<size_t>(special - pos_)};
+                pos_ = special + 1;
+            } else {
+                value = UnescapeString();
+            }
+            if (value.size() <= String::INLINE_CAPACITY) {
+                return String(value);
+            }
+            if (is_plain && borrow_strings_) {
+                return String::Borrow(value);
+            }
+            return MakeString(value);
+        }
+
+        // Parses the rest of a string into a buffer, which is reused by all strings of the document
+        std::string_view UnescapeString() {
+            std::string& s = string_buffer_;
+            s.clear();
             while (true) {
-                if (it == end) {
+                const char* special = FindStringSpecial(pos_, end_);
+                s.append(pos_, special);
+                if (special == end_) {
                     throw ParsingError("String parsing error");
                 }
-                const char ch = *it;
+                pos_ = special + 1;
+                const char ch = *special;
                 if (ch == '"') {
-                    ++it;
-                    break;
-                } else if (ch == '\\') {
-                    ++it;
-                    if (it == end) {
-                        throw ParsingError("String parsing error");
-                    }
-                    const char escaped_char = *(it);
-                    switch (escaped_char) {
-                        case 'n':
-                            s.push_back('\n');
-                            break;
-                        case 't':
-                            s.push_back('\t');
-                            break;
-                        case 'r':
-                            s.push_back('\r');
-                            break;
-                        case '"':
-                            s.push_back('"');
-                            break;
-                        case '\\':
-                            s.push_back('\\');
-                            break;
-                        default:
-                            throw ParsingError("Unrecognized escape sequence \\"s + escaped_char);
-                    }
-                } else if (ch == '\n' || ch == '\r') {
+                    return s;
+                }
+                if (ch != '\\') {
                     throw ParsingError("Unexpected end of line"s);
-                } else {
-                    s.push_back(ch);
                 }
-                ++it;
+                if (pos_ == end_) {
+                    throw ParsingError("String parsing error");
+                }
+                const char escaped_char = *pos_++;
+                switch (escaped_char) {
+                    case 'n':
+                        s.push_back('\n');
+                        break;
+                    case 't':
+                        s.push_back('\t');
+                        break;
+                    case 'r':
+                        s.push_back('\r');
+                        break;
+                    case 'b':
+                        s.push_back('\b');
+                        break;
+                    case 'f':
+                        s.push_back('\f');
+                        break;
+                    case '"':
+                        s.push_back('"');
+                        break;
+                    case '\\':
+                        s.push_back('\\');
+                        break;
+                    case '/':
+                        s.push_back('/');
+                        break;
+                    case 'u':
+                        AppendUtf8(s, LoadCodePoint());
+                        break;
+                    default:
+                        throw ParsingError("Unrecognized escape sequence \\"s + escaped_char);
+                }
+            }
+        }
+
+        String MakeString(std::string_view value) {
+            // Short strings are kept inline and never take memory of their own
+            if (arena_ == nullptr || value.size() <= String::INLINE_CAPACITY) {
+                return String(value);
+            }
+            char* data = static_cast<char*>(arena_->allocate(value.size(), 1));
+            std::copy(value.begin(), value.end(), data);
+            return String::Borrow({data, value.size()});
+        }
+
+        // Parses the hex digits of \uXXXX, joining a surrogate pair into one code point
+        uint32_t LoadCodePoint() {
+            auto load_hex = [this] {
+                uint32_t value = 0;
+                if (end_ - pos_ < 4) {
+                    throw ParsingError("String parsing error");
+                }
+                const auto [ptr, ec] = std::from_chars(pos_, pos_ + 4, value, 16);
+                if (ec != std::errc() || ptr != pos_ + 4) {
+                    throw ParsingError("Invalid \\u escape sequence"s);
+                }
+                pos_ += 4;
+                return value;
+            };
+            const uint32_t code_unit = load_hex();
+            if (code_unit < 0xD800 || code_unit > 0xDBFF) {
+                return code_unit;
+            }
+            if (end_ - pos_ < 2 || pos_[0] != '\\' || pos_[1] != 'u') {
+                throw ParsingError("Unpaired surrogate in \\u escape sequence"s);
             }
+            pos_ += 2;
+            const uint32_t low = load_hex();
+            if (low < 0xDC00 || low > 0xDFFF) {
+                throw ParsingError("Unpaired surrogate in \\u escape sequence"s);
+            }
+            return 0x10000 + ((code_unit - 0xD800) << 10) + (low - 0xDC00);
+        }
 
-            return Node(std::move(s));
+        std::string_view LoadLiteral() {
+            const char* begin = pos_;
+            while (pos_ != end_ && IsAlpha(*pos_)) {
+                ++pos_;
+            }
+            return {begin, static_cast<size_t>(pos_ - begin)};
         }
 
-        Node LoadBool(std::istream& input) {
-            const auto s = LoadLiteral(input);
+        Node LoadBool() {
+            const auto s = LoadLiteral();
             if (s == "true"sv) {
                 return Node{true};
             } else if (s == "false"sv) {
                 return Node{false};
             } else {
-                throw ParsingError("Failed to parse '"s + s + "' as bool"s);
+                throw ParsingError("Failed to parse '"s + std::string(s) + "' as bool"s);
             }
         }
 
-        Node LoadNull(std::istream& input) {
-            if (auto literal = LoadLiteral(input); literal == "null"sv) {
+        Node LoadNull() {
+            if (auto literal = LoadLiteral(); literal == "null"sv) {
                 return Node{nullptr};
             } else {
-                throw ParsingError("Failed to parse '"s + literal + "' as null"s);
+                throw ParsingError("Failed to parse '"s + std::string(literal) + "' as null"s);
             }
         }
 
-        Node LoadNumber(std::istream& input) {
-            std::string parsed_num;
-
-            // Считывает в parsed_num очередной символ из input
-            auto read_char = [&parsed_num, &input] {
-                parsed_num += static_cast<char>(input.get());
-                if (!input) {
-                    throw ParsingError("Failed to read number from stream"s);
-                }
-            };
+        Node LoadNumber() {
+            const char* begin = pos_;
 
-            // Считывает одну или более цифр в parsed_num из input
-            auto read_digits = [&input, read_char] {
-                if (!std::isdigit(input.peek())) {
+            // Skips one or more digits
+            auto skip_digits = [this] {
+                if (pos_ == end_ || !IsDigit(*pos_)) {
                     throw ParsingError("A digit is expected"s);
                 }
-                while (std::isdigit(input.peek())) {
-                    read_char();
+                while (pos_ != end_ && IsDigit(*pos_)) {
+                    ++pos_;
                 }
             };
 
-            if (input.peek() == '-') {
-                read_char();
+            if (pos_ != end_ && *pos_ == '-') {
+                ++pos_;
             }
-            // Парсим целую часть числа
-            if (input.peek() == '0') {
-                read_char();
-                // После 0 в JSON не могут идти другие цифры
+            if (pos_ != end_ && *pos_ == '0') {
+                // No more digits may follow 0 in JSON
+                ++pos_;
             } else {
-                read_digits();
+                skip_digits();
             }
 
             bool is_int = true;
-            // Парсим дробную часть числа
-            if (input.peek() == '.') {
-                read_char();
-                read_digits();
+            if (pos_ != end_ && *pos_ == '.') {
+                ++pos_;
+                skip_digits();
                 is_int = false;
             }
-
-            // Парсим экспоненциальную часть числа
-            if (int ch = input.peek(); ch == 'e' || ch == 'E') {
-                read_char();
-                if (ch = input.peek(); ch == '+' || ch == '-') {
-                    read_char();
+            if (pos_ != end_ && (*pos_ == 'e' || *pos_ == 'E')) {
+                ++pos_;
+                if (pos_ != end_ && (*pos_ == '+' || *pos_ == '-')) {
+                    ++pos_;
                 }
-                read_digits();
+                skip_digits();
                 is_int = false;
             }
 
-            try {
-                if (is_int) {
-                    // Сначала пробуем преобразовать строку в int
-                    try {
-                        return std::stoi(parsed_num);
-                    } catch (...) {
-                        // В случае неудачи, например, при переполнении
-                        // код ниже попробует преобразовать строку в double
-                    }
+            // The grammar has already been checked, so from_chars consumes the whole number
+            if (is_int) {
+                int value = 0;
+                if (const auto result = std::from_chars(begin, pos_, value); result.ec == std::errc()) {
+                    return value;
                 }
-                return std::stod(parsed_num);
-            } catch (...) {
-                throw ParsingError("Failed to convert "s + parsed_num + " to number"s);
+                // Integers which don't fit into int are kept as double
+            }
+            double value = 0.;
+            if (const auto result = std::from_chars(begin, pos_, value); result.ec != std::errc()) {
+                throw ParsingError("Failed to convert "s + std::string(begin, pos_) + " to number"s);
             }
+            return value;
         }
 
-        Node LoadNode(std::istream& input) {
-            char c;
-            if (!(input >> c)) {
-                throw ParsingError("Unexpected EOF"s);
-            }
-            switch (c) {
-                case '[':
-                    return LoadArray(input);
-                case '{':
-                    return LoadDict(input);
-                case '"':
-                    return LoadString(input);
-                case 't':
-                    // Атрибут [[fallthrough]] (провалиться) ничего не делает, и является
-                    // подсказкой компилятору и человеку, что здесь программист явно задумывал
-                    // разрешить переход к инструкции следующей ветки case, а не случайно забыл
-                    // написать break, return или throw.
-                    // В данном случае, встретив t или f, переходим к попытке парсинга
-                    // литералов true либо false
-                    [[fallthrough]];
-                case 'f':
-                    input.putback(c);
-                    return LoadBool(input);
-                case 'n':
-                    input.putback(c);
-                    return LoadNull(input);
-                default:
-                    input.putback(c);
-                    return LoadNumber(input);
+        const char* pos_;
+        const char* end_;
+        bool borrow_strings_;
+        std::pmr::memory_resource* arena_;
+        std::pmr::memory_resource* resource_;
+        std::string string_buffer_;
+        std::vector<Node> array_stack_;
+        std::vector<Dict::value_type> dict_stack_;
+    };
+
+    namespace {
+        // Short keys of a dict are inline, so they are compared without looking for their ends
+        void MakeKey(String& key) {
+            if (!key.IsInline() && key.View().size() <= String::INLINE_CAPACITY) {
+                key = String(key.View());
             }
         }
 
-        struct PrintContext {
-            std::ostream& out;
-            int indent_step = 4;
-            int indent = 0;
+        // Dicts of more keys are searched through a hash index
+        constexpr size_t MAX_LINEAR_DICT_SIZE = 8;
 
-            void PrintIndent() const {
-                for (int i = 0; i < indent; ++i) {
-                    out.put(' ');
-                }
+        // Memory of an arena document: the blocks its nodes are allocated from and the source
+        // its strings may borrow from
+        struct Arena {
+            Arena(size_t initial_size, std::shared_ptr<const void> source)
+                : source(std::move(source))
+                , resource(initial_size) {
             }
 
-            PrintContext Indented() const {
-                return {out, indent_step, indent_step + indent};
-            }
+            std::shared_ptr<const void> source;
+            std::pmr::monotonic_buffer_resource resource;
         };
 
-        void PrintNode(const Node& value, const PrintContext& ctx);
+        // A tree takes about as much memory as its text, so the first block is sized after the text
+        constexpr size_t MIN_ARENA_BLOCK_SIZE = 4096;
 
-        template <typename Value>
-        void PrintValue(const Value& value, const PrintContext& ctx) {
-            ctx.out << value;
+        Document LoadInArena(std::string_view text, bool borrow_strings, std::shared_ptr<const void> source) {
+            auto arena = std::make_shared<Arena>(std::max(MIN_ARENA_BLOCK_SIZE, text.size()), std::move(source));
+            Node root = Parser(text, borrow_strings, &arena->resource).LoadDocument();
+            // The root is moved into the arena too, so that nothing of the tree has to be destroyed
+            void* root_memory = arena->resource.allocate(sizeof(Node), alignof(Node));
+            const Node* arena_root = new (root_memory) Node(std::move(root));
+            return Document{arena_root, std::move(arena)};
         }
 
-        void PrintString(const std::string& value, std::ostream& out) {
-            out.put('"');
-            for (const char c : value) {
-                switch (c) {
-                    case '\r':
-                        out << "\\r"sv;
-                        break;
-                    case '\n':
-                        out << "\\n"sv;
-                        break;
-                    case '"':
-                        // Символы " и \ выводятся как \" или \\, соответственно
-                        [[fallthrough]];
-                    case '\\':
-                        out.put('\\');
-                        [[fallthrough]];
-                    default:
-                        out.put(c);
-                        break;
+        constexpr size_t INDENT_STEP = 4;
+        // The buffer of a writer is written to the stream when it grows this large
+        constexpr size_t FLUSH_SIZE = 1 << 16;
+        // Doubles have at most 17 significant digits, further ones are always zeros
+        constexpr int MAX_DOUBLE_PRECISION = 17;
+
+        // A reader takes its stream in blocks of this size, or larger when a value doesn't fit
+        constexpr size_t READER_BLOCK_SIZE = 1 << 16;
+
+        // The scanners find where a value which starts at pos ends without parsing it.
+        // They return nullptr if the value may go on past end
+
+        // Scans the rest of a string after the opening quote
+        const char* ScanString(const char* pos, const char* end) {
+            while (true) {
+                pos = FindStringSpecial(pos, end);
+                if (pos == end) {
+                    return nullptr;
+                }
+                if (*pos != '\\') {
+                    // The closing quote, or a line break which the parser reports
+                    return pos + 1;
+                }
+                if (end - pos < 2) {
+                    return nullptr;
+                }
+                pos += 2;
+            }
+        }
+
+        const char* ScanScalar(const char* pos, const char* end) {
+            while (pos != end && (IsAlpha(*pos) || IsDigit(*pos) || *pos == '-' || *pos == '+' || *pos == '.')) {
+                ++pos;
+            }
+            return pos == end ? nullptr : pos;
+        }
+
+        const char* ScanValue(const char* pos, const char* end) {
+            if (pos == end) {
+                return nullptr;
+            }
+            if (*pos == '"') {
+                return ScanString(pos + 1, end);
+            }
+            if (*pos != '[' && *pos != '{') {
+                return ScanScalar(pos, end);
+            }
+            // Brackets are only counted, mismatched ones are reported by the parser
+            size_t depth = 0;
+            while (pos != end) {
+                const char c = *pos;
+                if (c == '"') {
+                    pos = ScanString(pos + 1, end);
+                    if (pos == nullptr) {
+                        return nullptr;
+                    }
+                    continue;
+                }
+                if (c == '[' || c == '{') {
+                    ++depth;
+                } else if ((c == ']' || c == '}') && --depth == 0) {
+                    return pos + 1;
                 }
+                ++pos;
             }
-            out.put('"');
+            return nullptr;
+        }
+
+    }  // namespace
+
+    String::String(const std::string& value) {
+        Assign(value);
+    }
+
+    String::String(const char* value) {
+        Assign(value);
+    }
+
+    String::String(std::string_view value) {
+        Assign(value);
+    }
+
+    String::~String() {
+        Release();
+    }
+
+    String::String(const String& other) {
+        // A copy may outlive the buffer a borrowed string points into
+        if (other.kind_ == Kind::OWNED || other.kind_ == Kind::BORROWED) {
+            Assign(other.View());
+        } else {
+            std::memcpy(storage_, other.storage_, sizeof(storage_));
+            inline_size_ = other.inline_size_;
+            kind_ = other.kind_;
+        }
+    }
+
+    String& String::operator=(const String& other) {
+        if (this != &other) {
+            String copy(other);
+            *this = std::move(copy);
+        }
+        return *this;
+    }
+
+    String::String(String&& other) noexcept {
+        std::memcpy(storage_, other.storage_, sizeof(storage_));
+        inline_size_ = std::exchange(other.inline_size_, 0);
+        kind_ = std::exchange(other.kind_, Kind::INLINE);
+        std::memset(other.storage_, 0, sizeof(other.storage_));
+    }
+
+    String& String::operator=(String&& other) noexcept {
+        if (this != &other) {
+            Release();
+            std::memcpy(storage_, other.storage_, sizeof(storage_));
+            inline_size_ = std::exchange(other.inline_size_, 0);
+            kind_ = std::exchange(other.kind_, Kind::INLINE);
+            std::memset(other.storage_, 0, sizeof(other.storage_));
+        }
+        return *this;
+    }
+
+    String String::Borrow(std::string_view value) {
+        String result;
+        result.SetData(value.data(), value.size(), Kind::BORROWED);
+        return result;
+    }
+
+    bool String::IsBorrowed() const {
+        return kind_ == Kind::BORROWED;
+    }
+
+    bool String::IsInline() const {
+        return kind_ == Kind::INLINE;
+    }
+
+    void String::Assign(std::string_view value) {
+        if (value.size() <= INLINE_CAPACITY) {
+            std::copy(value.begin(), value.end(), storage_);
+            inline_size_ = static_cast<uint8_t>(value.size());
+            return;
+        }
+        char* data = new char[value.size()];
+        std::copy(value.begin(), value.end(), data);
+        SetData(data, value.size(), Kind::OWNED);
+    }
+
+    void String::SetData(const char* data, size_t size, Kind kind) {
+        if (size > std::numeric_limits<uint32_t>::max()) {
+            throw std::length_error("String is too long"s);
+        }
+        const auto size32 = static_cast<uint32_t>(size);
+        std::memcpy(storage_, &data, sizeof(data));
+        std::memcpy(storage_ + sizeof(data), &size32, sizeof(size32));
+        kind_ = kind;
+    }
+
+    void String::Release() {
+        if (kind_ == Kind::OWNED) {
+            delete[] GetData();
+        }
+    }
+
+    bool operator==(const String& lhs, const String& rhs) {
+        using Kind = String::Kind;
+        if (lhs.kind_ == Kind::INLINE && rhs.kind_ == Kind::INLINE) {
+            return lhs.inline_size_ == rhs.inline_size_ && std::memcmp(lhs.storage_, rhs.storage_, sizeof(lhs.storage_)) == 0;
+        }
+        return lhs.View() == rhs.View();
+    }
+
+    bool operator!=(const String& lhs, const String& rhs) {
+        return !(lhs == rhs);
+    }
+
+    bool operator<(const String& lhs, const String& rhs) {
+        return lhs.View() < rhs.View();
+    }
+
+    std::ostream& operator<<(std::ostream& output, const String& value) {
+        return output << value.View();
+    }
+
+    Dict::Dict(const allocator_type& allocator)
+        : items_(allocator) {
+    }
+
+    Dict::Dict(std::initializer_list<value_type> items, const allocator_type& allocator)
+        : items_(items, allocator) {
+        Normalize();
+    }
+
+    Dict::~Dict() {
+        ReleaseIndex();
+    }
+
+    Dict::Dict(const Dict& other)
+        : items_(other.items_) {
+        BuildIndex();
+    }
+
+    Dict& Dict::operator=(const Dict& other) {
+        if (this != &other) {
+            items_ = other.items_;
+            BuildIndex();
         }
+        return *this;
+    }
+
+    Dict::Dict(Dict&& other) noexcept
+        : items_(std::move(other.items_))
+        , index_(std::exchange(other.index_, nullptr))
+        , index_size_(std::exchange(other.index_size_, 0)) {
+    }
 
-        template <>
-        void PrintValue<std::string>(const std::string& value, const PrintContext& ctx) {
-            PrintString(value, ctx.out);
+    Dict& Dict::operator=(Dict&& other) {
+        if (this == &other) {
+            return *this;
         }
+        if (get_allocator() != other.get_allocator()) {
+            // The items are moved one by one into the resource of this dict, so is the index
+            items_ = std::move(other.items_);
+            other.items_.clear();
+            other.ReleaseIndex();
+            BuildIndex();
+            return *this;
+        }
+        ReleaseIndex();
+        items_ = std::move(other.items_);
+        other.items_.clear();
+        index_ = std::exchange(other.index_, nullptr);
+        index_size_ = std::exchange(other.index_size_, 0);
+        return *this;
+    }
+
+    Dict::const_iterator Dict::begin() const {
+        return items_.begin();
+    }
+
+    Dict::const_iterator Dict::end() const {
+        return items_.end();
+    }
 
-        template <>
-        void PrintValue<std::nullptr_t>(const std::nullptr_t&, const PrintContext& ctx) {
-            ctx.out << "null"sv;
+    size_t Dict::size() const {
+        return items_.size();
+    }
+
+    bool Dict::empty() const {
+        return items_.empty();
+    }
+
+    Dict::allocator_type Dict::get_allocator() const {
+        return items_.get_allocator();
+    }
+
+    Dict::const_iterator Dict::find(std::string_view key) const {
+        return items_.begin() + static_cast<std::ptrdiff_t>(FindPosition(key));
+    }
+
+    size_t Dict::count(std::string_view key) const {
+        return FindPosition(key) == items_.size() ? 0 : 1;
+    }
+
+    const Node& Dict::at(std::string_view key) const {
+        const size_t position = FindPosition(key);
+        if (position == items_.size()) {
+            throw std::out_of_range("Key '"s + std::string(key) + "' is not found"s);
         }
+        return items_[position].second;
+    }
+
+    Node& Dict::at(std::string_view key) {
+        return const_cast<Node&>(std::as_const(*this).at(key));
+    }
 
-        // В специализаци шаблона PrintValue для типа bool параметр value передаётся
-        // по константной ссылке, как и в основном шаблоне.
-        // В качестве альтернативы можно использовать перегрузку:
-        // void PrintValue(bool value, const PrintContext& ctx);
-        template <>
-        void PrintValue<bool>(const bool& value, const PrintContext& ctx) {
-            ctx.out << (value ? "true"sv : "false"sv);
+    Node& Dict::operator[](std::string_view key) {
+        if (const size_t position = FindPosition(key); position != items_.size()) {
+            return items_[position].second;
         }
+        const auto it = emplace(String(key), Node{}).first;
+        return items_[static_cast<size_t>(it - items_.begin())].second;
+    }
 
-        template <>
-        void PrintValue<Array>(const Array& nodes, const PrintContext& ctx) {
-            std::ostream& out = ctx.out;
-            out << "[\n"sv;
-            bool first = true;
-            auto inner_ctx = ctx.Indented();
-            for (const Node& node : nodes) {
-                if (first) {
-                    first = false;
-                } else {
-                    out << ",\n"sv;
+    std::pair<Dict::const_iterator, bool> Dict::emplace(String key, Node value) {
+        MakeKey(key);
+        const std::string_view key_view = key.View();
+        // Keys usually come sorted, then the item is appended without a search
+        auto it = items_.end();
+        if (!items_.empty() && !(items_.back().first.View() < key_view)) {
+            it = std::lower_bound(items_.begin(), items_.end(), key_view, [](const value_type& item, std::string_view key) {
+                return item.first.View() < key;
+            });
+            if (it->first.View() == key_view) {
+                return {it, false};
+            }
+        }
+        const size_t position = static_cast<size_t>(it - items_.begin());
+        it = items_.emplace(it, std::move(key), std::move(value));
+        if (index_ != nullptr && 2 * items_.size() <= index_size_) {
+            AddToIndex(position);
+        } else if (items_.size() > MAX_LINEAR_DICT_SIZE) {
+            // The index doubles when it is rebuilt, so appends take amortized constant time
+            BuildIndex();
+        }
+        return {it, true};
+    }
+
+    void Dict::Normalize() {
+        for (auto& item : items_) {
+            MakeKey(item.first);
+        }
+        auto key_less = [](const value_type& lhs, const value_type& rhs) {
+            return lhs.first.View() < rhs.first.View();
+        };
+        if (!std::is_sorted(items_.begin(), items_.end(), key_less)) {
+            std::stable_sort(items_.begin(), items_.end(), key_less);
+        }
+        items_.erase(std::unique(items_.begin(), items_.end(), [](const value_type& lhs, const value_type& rhs) {
+            return lhs.first.View() == rhs.first.View();
+        }), items_.end());
+        BuildIndex();
+    }
+
+    size_t Dict::FindPosition(std::string_view key) const {
+        // Short keys are inline, so they are compared as a whole without looking for their ends
+        const bool is_short = key.size() <= String::INLINE_CAPACITY;
+        const String short_key = is_short ? String(key) : String();
+        auto matches = [is_short, &short_key, key](const String& item_key) {
+            return is_short ? item_key == short_key : item_key.View() == key;
+        };
+        if (index_ == nullptr) {
+            for (size_t position = 0; position < items_.size(); ++position) {
+                if (matches(items_[position].first)) {
+                    return position;
                 }
-                inner_ctx.PrintIndent();
-                PrintNode(node, inner_ctx);
             }
-            out.put('\n');
-            ctx.PrintIndent();
-            out.put(']');
+            return items_.size();
+        }
+        const uint32_t mask = index_size_ - 1;
+        for (uint32_t slot = std::hash<std::string_view>{}(key) & mask; index_[slot] != 0; slot = (slot + 1) & mask) {
+            const size_t position = index_[slot] - 1;
+            if (matches(items_[position].first)) {
+                return position;
+            }
         }
+        return items_.size();
+    }
 
-        template <>
-        void PrintValue<Dict>(const Dict& nodes, const PrintContext& ctx) {
-            std::ostream& out = ctx.out;
-            out << "{\n"sv;
-            bool first = true;
-            auto inner_ctx = ctx.Indented();
-            for (const auto& [key, node] : nodes) {
-                if (first) {
-                    first = false;
-                } else {
-                    out << ",\n"sv;
+    void Dict::BuildIndex() {
+        ReleaseIndex();
+        if (items_.size() <= MAX_LINEAR_DICT_SIZE) {
+            return;
+        }
+        if (items_.size() >= std::numeric_limits<uint32_t>::max() / 2) {
+            throw std::length_error("Dict is too large"s);
+        }
+        // At most half of the slots are taken, so probe sequences stay short
+        uint32_t index_size = 1;
+        while (index_size < 2 * items_.size()) {
+            index_size *= 2;
+        }
+        auto* resource = items_.get_allocator().resource();
+        index_ = static_cast<uint32_t*>(resource->allocate(index_size * sizeof(uint32_t), alignof(uint32_t)));
+        index_size_ = index_size;
+        std::fill(index_, index_ + index_size_, 0);
+        for (size_t position = 0; position < items_.size(); ++position) {
+            InsertSlot(position);
+        }
+    }
+
+    void Dict::AddToIndex(size_t position) {
+        if (position + 1 < items_.size()) {
+            // The items after the new one have moved one position further
+            for (uint32_t slot = 0; slot < index_size_; ++slot) {
+                if (index_[slot] > position) {
+                    ++index_[slot];
                 }
-                inner_ctx.PrintIndent();
-                PrintString(key, ctx.out);
-                out << ": "sv;
-                PrintNode(node, inner_ctx);
             }
-            out.put('\n');
-            ctx.PrintIndent();
-            out.put('}');
         }
+        InsertSlot(position);
+    }
 
-        void PrintNode(const Node& node, const PrintContext& ctx) {
-            std::visit(
-                [&ctx](const auto& value) {
-                    PrintValue(value, ctx);
-                },
-                node.GetValue());
+    void Dict::InsertSlot(size_t position) {
+        const uint32_t mask = index_size_ - 1;
+        uint32_t slot = std::hash<std::string_view>{}(items_[position].first.View()) & mask;
+        while (index_[slot] != 0) {
+            slot = (slot + 1) & mask;
         }
+        index_[slot] = static_cast<uint32_t>(position + 1);
+    }
 
-    }  // namespace
+    void Dict::ReleaseIndex() {
+        if (index_ != nullptr) {
+            items_.get_allocator().resource()->deallocate(index_, index_size_ * sizeof(uint32_t), alignof(uint32_t));
+            index_ = nullptr;
+            index_size_ = 0;
+        }
+    }
+
+    bool operator==(const Dict& lhs, const Dict& rhs) {
+        return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+    }
+
+    bool operator!=(const Dict& lhs, const Dict& rhs) {
+        return !(lhs == rhs);
+    }
 
     bool Node::IsInt() const {
         return std::holds_alternative<int>(*this);
@@ -389,14 +980,14 @@ namespace json {
     }
 
     bool Node::IsString() const {
-        return std::holds_alternative<std::string>(*this);
+        return std::holds_alternative<String>(*this);
     }
-    const std::string& Node::AsString() const {
+    std::string_view Node::AsString() const {
         if (!IsString()) {
             throw std::logic_error("Not a string"s);
         }
 
-        return std::get<std::string>(*this);
+        return std::get<String>(*this).View();
     }
 
     bool Node::IsDict() const {
@@ -441,8 +1032,18 @@ namespace json {
         : root_(std::move(root))
     {}
 
+    Document::Document(Node root, std::shared_ptr<const void> storage)
+        : storage_(std::move(storage))
+        , root_(std::move(root))
+    {}
+
+    Document::Document(const Node* root, std::shared_ptr<const void> storage)
+        : storage_(std::move(storage))
+        , storage_root_(root)
+    {}
+
     const Node& Document::GetRoot() const {
-        return root_;
+        return storage_root_ != nullptr ? *storage_root_ : root_;
     }
 
     bool operator==(const Document& lhs, const Document& rhs) {
@@ -453,12 +1054,471 @@ namespace json {
         return !(lhs == rhs);
     }
 
-    Document Load(std::istream& input) {
-        return Document{LoadNode(input)};
+    Document Load(std::istream& input, Allocation allocation) {
+        std::string text = ReadAll(input);
+        if (allocation == Allocation::ARENA) {
+            auto source = std::make_shared<const std::string>(std::move(text));
+            const std::string_view source_text(*source);
+            return LoadInArena(source_text, true, std::move(source));
+        }
+        return Load(std::string_view(text));
+    }
+
+    Document Load(std::string_view text, Allocation allocation) {
+        if (allocation == Allocation::ARENA) {
+            return LoadInArena(text, false, nullptr);
+        }
+        return Document{Parser(text, false).LoadDocument()};
+    }
+
+    Document LoadFile(const std::string& path, Allocation allocation) {
+        auto file = std::make_shared<const mapped_file::MappedFile>(path);
+        const std::string_view text(file->Data(), file->Size());
+        if (allocation == Allocation::ARENA) {
+            return LoadInArena(text, true, std::move(file));
+        }
+        Node root = Parser(text, true).LoadDocument();
+        return Document{std::move(root), std::move(file)};
+    }
+
+    Reader::Reader(std::istream& input)
+        : input_(&input)
+        , pos_(window_.data())
+        , end_(window_.data())
+        , parser_(std::make_unique<Parser>(std::string_view(), false)) {
+    }
+
+    Reader::Reader(std::string_view text)
+        : pos_(text.data())
+        , end_(text.data() + text.size())
+        , parser_(std::make_unique<Parser>(std::string_view(), false)) {
+    }
+
+    Reader::~Reader() = default;
+
+    Reader::ValueType Reader::PeekType() {
+        switch (PeekChar()) {
+            case '[':
+                return ValueType::ARRAY;
+            case '{':
+                return ValueType::DICT;
+            case '"':
+                return ValueType::STRING;
+            case 't':
+                [[fallthrough]];
+            case 'f':
+                return ValueType::BOOL;
+            case 'n':
+                return ValueType::NULL_VALUE;
+            default:
+                return ValueType::NUMBER;
+        }
+    }
+
+    void Reader::StartArray() {
+        if (PeekChar() != '[') {
+            throw std::logic_error("Not an array"s);
+        }
+        ++pos_;
+        empty_containers_.push_back(true);
+    }
+
+    bool Reader::NextElement() {
+        return NextItem(']');
+    }
+
+    void Reader::StartDict() {
+        if (PeekChar() != '{') {
+            throw std::logic_error("Not a dict"s);
+        }
+        ++pos_;
+        empty_containers_.push_back(true);
+    }
+
+    std::optional<std::string_view> Reader::NextKey() {
+        if (!NextItem('}')) {
+            return std::nullopt;
+        }
+        if (PeekChar() != '"') {
+            throw ParsingError(R"('"' is expected but ')"s + *pos_ + "' has been found"s);
+        }
+        // The key is copied, as looking for the colon may move the window
+        key_ = ReadString();
+        Expect(':');
+        return key_;
+    }
+
+    std::string_view Reader::ReadString() {
+        if (PeekChar() != '"') {
+            throw std::logic_error("Not a string"s);
+        }
+        ++pos_;
+        EnsureInWindow(ScanString);
+        // Strings without escape sequences are taken right from the window
+        const char* special = FindStringSpecial(pos_, end_);
+        if (special != end_ && *special == '"') {
+            const std::string_view value(pos_, static_cast<size_t>(special - pos_));
+            pos_ = special + 1;
+            return value;
+        }
+        parser_->Reset(pos_, end_);
+        string_ = parser_->LoadString();
+        pos_ = parser_->GetPosition();
+        return string_.View();
+    }
+
+    int Reader::ReadInt() {
+        return ReadValue().AsInt();
+    }
+
+    double Reader::ReadDouble() {
+        return ReadValue().AsDouble();
+    }
+
+    bool Reader::ReadBool() {
+        return ReadValue().AsBool();
+    }
+
+    void Reader::ReadNull() {
+        if (!ReadValue().IsNull()) {
+            throw std::logic_error("Not a null"s);
+        }
+    }
+
+    Node Reader::ReadValue() {
+        PeekChar();
+        EnsureInWindow(ScanValue);
+        parser_->Reset(pos_, end_);
+        Node value = parser_->LoadNode();
+        pos_ = parser_->GetPosition();
+        return value;
+    }
+
+    void Reader::SkipValue() {
+        // Containers are skipped item by item, so a large one never has to fit into the window
+        switch (PeekType()) {
+            case ValueType::ARRAY:
+                StartArray();
+                while (NextElement()) {
+                    SkipValue();
+                }
+                break;
+            case ValueType::DICT:
+                StartDict();
+                while (NextKey()) {
+                    SkipValue();
+                }
+                break;
+            case ValueType::STRING:
+                ReadString();
+                break;
+            default:
+                ReadValue();
+        }
+    }
+
+    char Reader::PeekChar() {
+        while (true) {
+            pos_ = SkipSpaces(pos_, end_);
+            if (pos_ != end_) {
+                return *pos_;
+            }
+            if (!Refill()) {
+                throw ParsingError("Unexpected EOF"s);
+            }
+        }
+    }
+
+    void Reader::Expect(char c) {
+        if (const char found = PeekChar(); found != c) {
+            throw ParsingError("'"s + c + "' is expected but '"s + found + "' has been found"s);
+        }
+        ++pos_;
+    }
+
+    bool Reader::NextItem(char closing_bracket) {
+        if (empty_containers_.empty()) {
+            throw std::logic_error("No container is open"s);
+        }
+        if (PeekChar() == closing_bracket) {
+            ++pos_;
+            empty_containers_.pop_back();
+            return false;
+        }
+        if (!empty_containers_.back()) {
+            Expect(',');
+        }
+        empty_containers_.back() = false;
+        return true;
+    }
+
+    bool Reader::Refill() {
+        if (input_ == nullptr || !*input_) {
+            return false;
+        }
+        window_.erase(0, static_cast<size_t>(pos_ - window_.data()));
+        const size_t old_size = window_.size();
+        // The window doubles while a value doesn't fit into it, so a long value is rescanned only a few times
+        const size_t block_size = std::max(READER_BLOCK_SIZE, old_size);
+        window_.resize(old_size + block_size);
+        input_->read(window_.data() + old_size, static_cast<std::streamsize>(block_size));
+        const auto read_size = static_cast<size_t>(input_->gcount());
+        window_.resize(old_size + read_size);
+        pos_ = window_.data();
+        end_ = window_.data() + window_.size();
+        return read_size > 0;
+    }
+
+    template <typename Scan>
+    void Reader::EnsureInWindow(Scan scan) {
+        // An incomplete value at the end of the stream is left for the parser to report
+        while (input_ != nullptr && scan(pos_, end_) == nullptr && Refill()) {
+        }
     }
 
-    void Print(const Document& doc, std::ostream& output) {
-        PrintNode(doc.GetRoot(), PrintContext{output});
+    void Print(const Document& doc, std::ostream& output, const PrintSettings& settings) {
+        Writer writer(output, settings);
+        writer.Value(doc.GetRoot().GetValue());
+        writer.Flush();
+    }
+
+    Writer::Writer(std::ostream& output, const PrintSettings& settings)
+        : output_(output)
+        , compact_(settings.compact)
+        , double_precision_(std::clamp(settings.double_precision, 0, MAX_DOUBLE_PRECISION))
+    {}
+
+    Writer::Writer(std::ostream& output, const PrintSettings& settings, size_t depth)
+        : Writer(output, settings) {
+        empty_containers_.assign(depth, false);
+    }
+
+    void Writer::StartDict() {
+        StartItem();
+        buffer_.push_back('{');
+        empty_containers_.push_back(true);
+    }
+
+    void Writer::Key(std::string_view key) {
+        StartItem();
+        WriteString(key);
+        buffer_.append(compact_ ? ":"sv : ": "sv);
+        after_key_ = true;
+    }
+
+    void Writer::EndDict() {
+        EndContainer('}');
+    }
+
+    void Writer::StartArray() {
+        StartItem();
+        buffer_.push_back('[');
+        empty_containers_.push_back(true);
+    }
+
+    void Writer::EndArray() {
+        EndContainer(']');
+    }
+
+    void Writer::Value(const Node::Value& value) {
+        StartItem();
+        WriteNode(value, empty_containers_.size());
+        FlushIfFull();
+    }
+
+    void Writer::Splice(std::string_view items) {
+        if (after_key_ || empty_containers_.empty()) {
+            throw std::logic_error("Items can only be spliced into a container"s);
+        }
+        if (items.empty()) {
+            return;
+        }
+        empty_containers_.back() = false;
+        buffer_.append(items);
+        FlushIfFull();
+    }
+
+    void Writer::Flush() {
+        output_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+        buffer_.clear();
+    }
+
+    // Separates an item from the previous one of its container and puts it on its own line,
+    // unless it's the value of a key
+    void Writer::StartItem() {
+        if (after_key_) {
+            after_key_ = false;
+            return;
+        }
+        if (empty_containers_.empty()) {
+            return;
+        }
+        if (!empty_containers_.back()) {
+            buffer_.push_back(',');
+        }
+        empty_containers_.back() = false;
+        WriteNewLine();
+        WriteIndent(empty_containers_.size());
+    }
+
+    void Writer::EndContainer(char bracket) {
+        if (empty_containers_.back()) {
+            // Print makes an empty line inside an empty container
+            WriteNewLine();
+        }
+        empty_containers_.pop_back();
+        WriteNewLine();
+        WriteIndent(empty_containers_.size());
+        buffer_.push_back(bracket);
+        FlushIfFull();
+    }
+
+    void Writer::FlushIfFull() {
+        if (buffer_.size() >= FLUSH_SIZE) {
+            Flush();
+        }
+    }
+
+    void Writer::WriteNewLine() {
+        if (!compact_) {
+            buffer_.push_back('\n');
+        }
+    }
+
+    void Writer::WriteIndent(size_t depth) {
+        if (!compact_) {
+            buffer_.append(depth * INDENT_STEP, ' ');
+        }
+    }
+
+    void Writer::WriteString(std::string_view value) {
+        buffer_.push_back('"');
+        const char* pos = value.data();
+        const char* end = value.data() + value.size();
+        while (true) {
+            // Plain runs are copied at once, only the special characters are escaped one by one
+            const char* special = FindStringSpecial(pos, end);
+            buffer_.append(pos, special);
+            if (special == end) {
+                break;
+            }
+            switch (*special) {
+                case '\r':
+                    buffer_.append("\\r"sv);
+                    break;
+                case '\n':
+                    buffer_.append("\\n"sv);
+                    break;
+                default:
+                    // Символы " и \ выводятся как \" или \\, соответственно
+                    buffer_.push_back('\\');
+                    buffer_.push_back(*special);
+                    break;
+            }
+            pos = special + 1;
+        }
+        buffer_.push_back('"');
+    }
+
+    void Writer::WriteNode(const Node::Value& value, size_t depth) {
+        std::visit(
+            [this, depth](const auto& alternative) {
+                WriteValue(alternative, depth);
+            },
+            value);
+    }
+
+    void Writer::WriteValue(std::nullptr_t, size_t) {
+        buffer_.append("null"sv);
+    }
+
+    void Writer::WriteValue(bool value, size_t) {
+        buffer_.append(value ? "true"sv : "false"sv);
+    }
+
+    void Writer::WriteValue(int value, size_t) {
+        char digits[16];
+        const auto result = std::to_chars(std::begin(digits), std::end(digits), value);
+        buffer_.append(digits, result.ptr);
+    }
+
+    void Writer::WriteValue(double value, size_t) {
+        // Enough for the shortest form of any double and for the maximal precision
+        char digits[MAX_DOUBLE_PRECISION + 16];
+        const auto result = double_precision_ == 0
+            ? std::to_chars(std::begin(digits), std::end(digits), value)
+            : std::to_chars(std::begin(digits), std::end(digits), value, std::chars_format::general, double_precision_);
+        buffer_.append(digits, result.ptr);
+    }
+
+    void Writer::WriteValue(const String& value, size_t) {
+        WriteString(value.View());
+    }
+
+    void Writer::WriteValue(const Array& nodes, size_t depth) {
+        buffer_.push_back('[');
+        WriteNewLine();
+        bool first = true;
+        for (const Node& node : nodes) {
+            if (first) {
+                first = false;
+            } else {
+                buffer_.push_back(',');
+                WriteNewLine();
+            }
+            WriteIndent(depth + 1);
+            WriteNode(node.GetValue(), depth + 1);
+            FlushIfFull();
+        }
+        WriteNewLine();
+        WriteIndent(depth);
+        buffer_.push_back(']');
+    }
+
+    void Writer::WriteValue(const Dict& nodes, size_t depth) {
+        buffer_.push_back('{');
+        WriteNewLine();
+        bool first = true;
+        for (const auto& [key, node] : nodes) {
+            if (first) {
+                first = false;
+            } else {
+                buffer_.push_back(',');
+                WriteNewLine();
+            }
+            WriteIndent(depth + 1);
+            WriteString(key.View());
+            buffer_.append(compact_ ? ":"sv : ": "sv);
+            WriteNode(node.GetValue(), depth + 1);
+            FlushIfFull();
+        }
+        WriteNewLine();
+        WriteIndent(depth);
+        buffer_.push_back('}');
+    }
+
+    ArrayPrinter::ArrayPrinter(std::ostream& output, const PrintSettings& settings)
+        : writer_(output, settings)
+    {
+        writer_.StartArray();
+        writer_.Flush();
+    }
+
+    void ArrayPrinter::Print(const Node& element) {
+        if (finished_) {
+            throw std::logic_error("Array is finished"s);
+        }
+        writer_.Value(element.GetValue());
+        writer_.Flush();
+    }
+
+    void ArrayPrinter::Finish() {
+        if (finished_) {
+            throw std::logic_error("Array is finished"s);
+        }
+        finished_ = true;
+        writer_.EndArray();
+        writer_.Flush();
     }
 
 }  // namespace json
@@ -1,16 +1,175 @@
 #pragma once
 
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
 #include <iostream>
-#include <map>
+#include <memory>
+#include <memory_resource>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
 #include <variant>
 #include <vector>
 
 namespace json {
 
+    // String which keeps a short value inline, owns a longer one or borrows its characters from
+    // the buffer a document has been parsed from. Borrowed strings are valid while the document is alive,
+    // their copies own their characters
+    class String {
+    public:
+        // Longer strings are allocated or borrowed
+        static constexpr size_t INLINE_CAPACITY = 14;
+
+        String() = default;
+        String(const std::string& value);
+        String(const char* value);
+        explicit String(std::string_view value);
+        ~String();
+
+        String(const String& other);
+        String& operator=(const String& other);
+        String(String&& other) noexcept;
+        String& operator=(String&& other) noexcept;
+
+        static String Borrow(std::string_view value);
+
+        std::string_view View() const {
+            if (kind_ == Kind::INLINE) {
+                return {storage_, inline_size_};
+            }
+            return {GetData(), GetSize()};
+        }
+
+        operator std::string_view() const {
+            return View();
+        }
+
+        bool IsBorrowed() const;
+        bool IsInline() const;
+
+        friend bool operator==(const String& lhs, const String& rhs);
+
+    private:
+        enum class Kind : uint8_t {
+            INLINE,
+            OWNED,
+            BORROWED,
+        };
+
+        const char* GetData() const {
+            const char* data;
+            std::memcpy(&data, storage_, sizeof(data));
+            return data;
+        }
+
+        uint32_t GetSize() const {
+            uint32_t size;
+            std::memcpy(&size, storage_ + sizeof(const char*), sizeof(size));
+            return size;
+        }
+
+        void Assign(std::string_view value);
+        void SetData(const char* data, size_t size, Kind kind);
+        void Release();
+
+        // Characters of an inline string, the rest of the storage is zeroed so that inline strings
+        // are compared as a whole. Any other string keeps its pointer and size here
+        alignas(const char*) char storage_[INLINE_CAPACITY] = {};
+        uint8_t inline_size_ = 0;
+        Kind kind_ = Kind::INLINE;
+    };
+
+    bool operator==(const String& lhs, const String& rhs);
+    bool operator!=(const String& lhs, const String& rhs);
+    bool operator<(const String& lhs, const String& rhs);
+
+    // Heterogeneous comparisons with anything viewable as a string
+    template <typename Other>
+    using EnableIfStringLike = std::enable_if_t<
+        !std::is_same_v<Other, String> && std::is_convertible_v<const Other&, std::string_view>, bool>;
+
+    template <typename Other, EnableIfStringLike<Other> = true>
+    bool operator<(const String& lhs, const Other& rhs) {
+        return lhs.View() < std::string_view(rhs);
+    }
+
+    template <typename Other, EnableIfStringLike<Other> = true>
+    bool operator<(const Other& lhs, const String& rhs) {
+        return std::string_view(lhs) < rhs.View();
+    }
+
+    std::ostream& operator<<(std::ostream& output, const String& value);
+
     class Node;
-    using Dict = std::map<std::string, Node>;
-    using Array = std::vector<Node>;
+
+    // Items are kept in a vector sorted by key, so a dict is printed in key order and takes
+    // a single allocation. Lookups compare keys one by one in small dicts and go through a hash
+    // index of item positions in larger ones. Lookups take std::string_view, so no key is made.
+    // Containers take their memory from a resource, so a document can be allocated in an arena
+    class Dict {
+    public:
+        using value_type = std::pair<String, Node>;
+        using allocator_type = std::pmr::polymorphic_allocator<value_type>;
+        // Keys can't be changed in place, as that would break the order
+        using const_iterator = std::pmr::vector<value_type>::const_iterator;
+        using iterator = const_iterator;
+
+        Dict() = default;
+        explicit Dict(const allocator_type& allocator);
+        Dict(std::initializer_list<value_type> items, const allocator_type& allocator = {});
+        // Items may come in any order, of equal keys the first one is kept
+        template <typename InputIt>
+        Dict(InputIt first, InputIt last, const allocator_type& allocator = {});
+        ~Dict();
+
+        Dict(const Dict& other);
+        Dict& operator=(const Dict& other);
+        Dict(Dict&& other) noexcept;
+        Dict& operator=(Dict&& other);
+
+        const_iterator begin() const;
+        const_iterator end() const;
+        size_t size() const;
+        bool empty() const;
+        allocator_type get_allocator() const;
+
+        const_iterator find(std::string_view key) const;
+        size_t count(std::string_view key) const;
+        const Node& at(std::string_view key) const;
+        Node& at(std::string_view key);
+        // Inserts a null node if there is no such key
+        Node& operator[](std::string_view key);
+        // A new key goes into the hash index in place, the index is rebuilt only when it grows.
+        // Keys which come before existing ones shift their positions, so a large dict is better
+        // made at once from a range than by inserts out of order
+        std::pair<const_iterator, bool> emplace(String key, Node value);
+
+    private:
+        // Sorts the items, drops duplicate keys and indexes a large dict
+        void Normalize();
+        size_t FindPosition(std::string_view key) const;
+        void BuildIndex();
+        // Indexes the item just inserted at the position, the index has to have room for it
+        void AddToIndex(size_t position);
+        // Puts the position into the first free slot of the probe sequence of its key
+        void InsertSlot(size_t position);
+        void ReleaseIndex();
+
+        std::pmr::vector<value_type> items_;
+        // Open addressing table of item positions plus one, zero is an empty slot.
+        // Allocated from the resource of the items, only for dicts which aren't small
+        uint32_t* index_ = nullptr;
+        uint32_t index_size_ = 0;
+    };
+
+    bool operator==(const Dict& lhs, const Dict& rhs);
+    bool operator!=(const Dict& lhs, const Dict& rhs);
+
+    using Array = std::pmr::vector<Node>;
 
     class ParsingError : public std::runtime_error {
     public:
@@ -18,7 +177,7 @@ namespace json {
     };
 
     class Node final
-        : private std::variant<std::nullptr_t, Array, Dict, bool, int, double, std::string> {
+        : private std::variant<std::nullptr_t, Array, Dict, bool, int, double, String> {
     public:
         using variant::variant;
         using Value = variant;
@@ -39,7 +198,7 @@ namespace json {
         const Array& AsArray() const;
 
         bool IsString() const;
-        const std::string& AsString() const;
+        std::string_view AsString() const;
 
         bool IsDict() const;
         const Dict& AsDict() const;
@@ -56,22 +215,188 @@ namespace json {
 
     bool operator!=(const Node& lhs, const Node& rhs);
 
+    template <typename InputIt>
+    Dict::Dict(InputIt first, InputIt last, const allocator_type& allocator)
+        : items_(first, last, allocator) {
+        Normalize();
+    }
+
     class Document {
     public:
         explicit Document(Node root);
+        // The storage keeps alive the buffer which borrowed strings of the root point into
+        Document(Node root, std::shared_ptr<const void> storage);
+        // The root lives in the storage and is released with it without being destroyed
+        Document(const Node* root, std::shared_ptr<const void> storage);
 
         const Node& GetRoot() const;
 
     private:
+        std::shared_ptr<const void> storage_;
         Node root_;
+        const Node* storage_root_ = nullptr;
     };
 
     bool operator==(const Document& lhs, const Document& rhs);
 
     bool operator!=(const Document& lhs, const Document& rhs);
 
-    Document Load(std::istream& input);
+    enum class Allocation {
+        // Every node, container and string is a separate heap allocation
+        HEAP,
+        // The whole document is allocated from a few large blocks, which are freed at once
+        // without destroying the nodes one by one
+        ARENA,
+    };
+
+    // Reads the input to the end and parses the document from memory.
+    // An arena document keeps the text and borrows its strings from it
+    Document Load(std::istream& input, Allocation allocation = Allocation::HEAP);
 
-    void Print(const Document& doc, std::ostream& output);
+    Document Load(std::string_view text, Allocation allocation = Allocation::HEAP);
+
+    // Maps the file into memory, strings of the document borrow their characters from the mapping
+    // unless they contain escape sequences
+    Document LoadFile(const std::string& path, Allocation allocation = Allocation::HEAP);
+
+    struct PrintSettings {
+        // No whitespace at all instead of every element on its own line, indented by four spaces a level
+        bool compact = false;
+        // Significant digits of doubles, as streams print them by default.
+        // Zero prints the shortest form which is parsed back to the same value
+        int double_precision = 6;
+    };
+
+    class Parser;
+
+    // Pull parser: the document is read value by value as the caller asks for them, so it never
+    // has to be in memory as a whole. A stream is read through a window, which grows only to hold
+    // the value being read. Strings and keys returned by the reader are valid until its next call
+    class Reader {
+    public:
+        enum class ValueType {
+            NULL_VALUE,
+            BOOL,
+            NUMBER,
+            STRING,
+            ARRAY,
+            DICT,
+        };
+
+        explicit Reader(std::istream& input);
+        // The text has to outlive the reader
+        explicit Reader(std::string_view text);
+        ~Reader();
+
+        ValueType PeekType();
+
+        void StartArray();
+        // Whether the array has one more element, otherwise its closing bracket is consumed
+        bool NextElement();
+
+        void StartDict();
+        // The next key of the dict, or nullopt when its closing brace has been consumed
+        std::optional<std::string_view> NextKey();
+
+        std::string_view ReadString();
+        int ReadInt();
+        double ReadDouble();
+        bool ReadBool();
+        void ReadNull();
+
+        // Reads the value with all of its nested nodes, which own their strings
+        Node ReadValue();
+        void SkipValue();
+
+    private:
+        char PeekChar();
+        void Expect(char c);
+        bool NextItem(char closing_bracket);
+        bool Refill();
+        template <typename Scan>
+        void EnsureInWindow(Scan scan);
+
+        std::istream* input_ = nullptr;
+        // The unread part of the stream which has been taken into memory
+        std::string window_;
+        const char* pos_;
+        const char* end_;
+        std::unique_ptr<Parser> parser_;
+        std::string key_;
+        String string_;
+        // Whether each of the open containers is still empty, the innermost last
+        std::vector<bool> empty_containers_;
+    };
+
+    void Print(const Document& doc, std::ostream& output, const PrintSettings& settings = {});
+
+    // Writes a document piece by piece into a buffer, which is written to the stream in large blocks,
+    // formatted as Print formats the whole document.
+    // Keys, values and containers have to come in a valid order, the writer doesn't check it
+    class Writer {
+    public:
+        explicit Writer(std::ostream& output, const PrintSettings& settings = {});
+        // Continues as many open containers which aren't empty, so that what it writes can be
+        // spliced into the output of a writer with the same settings at the same depth
+        Writer(std::ostream& output, const PrintSettings& settings, size_t depth);
+
+        void StartDict();
+        void Key(std::string_view key);
+        void EndDict();
+
+        void StartArray();
+        void EndArray();
+
+        // Writes the value with all of its nested nodes
+        void Value(const Node::Value& value);
+
+        // Writes items which a writer made for this depth has written as they are. Into an empty
+        // container go only items written as the first ones of theirs, other items follow the others
+        void Splice(std::string_view items);
+
+        // The writer flushes the buffer by itself only when it grows large
+        void Flush();
+
+    private:
+        void StartItem();
+        void EndContainer(char bracket);
+        void FlushIfFull();
+
+        void WriteNewLine();
+        void WriteIndent(size_t depth);
+        void WriteString(std::string_view value);
+        void WriteNode(const Node::Value& value, size_t depth);
+        void WriteValue(std::nullptr_t, size_t depth);
+        void WriteValue(bool value, size_t depth);
+        void WriteValue(int value, size_t depth);
+        void WriteValue(double value, size_t depth);
+        void WriteValue(const String& value, size_t depth);
+        void WriteValue(const Array& nodes, size_t depth);
+        void WriteValue(const Dict& nodes, size_t depth);
+
+        std::ostream& output_;
+        std::string buffer_;
+        bool compact_;
+        int double_precision_;
+        // Whether each of the open containers is still empty, the innermost last
+        std::vector<bool> empty_containers_;
+        bool after_key_ = false;
+    };
+
+    // Prints an array element by element the same way Print prints the whole array,
+    // so the elements don't have to be kept in memory until the last one is ready
+    class ArrayPrinter {
+    public:
+        explicit ArrayPrinter(std::ostream& output, const PrintSettings& settings = {});
+
+        void Print(const Node& element);
+
+        // Closes the array, nothing can be printed after it
+        void Finish();
+
+    private:
+        Writer writer_;
+        bool finished_ = false;
+    };
 
 }  // namespace json
@@ -85,14 +85,48 @@ namespace json {
         return builder_->EndArray();
     }
 
+    Builder::Builder(Writer& writer) :
+        writer_(&writer)
+    {}
+
+    bool Builder::IsComplete() const {
+        return writer_ != nullptr ? written_dicts_.empty() : nodes_stack_.empty();
+    }
+
+    bool Builder::InDict() const {
+        return writer_ != nullptr ? written_dicts_.back() : nodes_stack_.back()->IsDict();
+    }
+
+    bool Builder::InArray() const {
+        return writer_ != nullptr ? !written_dicts_.back() : nodes_stack_.back()->IsArray();
+    }
+
+    // Checks that a value may come now, and writes its key if it's the value of a dict
+    void Builder::StartWrittenItem() {
+        if (!started_) {
+            started_ = true;
+            return;
+        }
+        if (written_dicts_.empty()) {
+            throw std::logic_error("Object complete.");
+        }
+        if (written_dicts_.back()) {
+            if (!key_.has_value()) {
+                throw std::logic_error("Key not set.");
+            }
+            writer_->Key(*key_);
+            key_.reset();
+        }
+    }
+
     KeyContext Builder::Key(const std::string& key) {
         if (!started_) {
             throw std::logic_error("Not in Dict context.");
         }
-        if (nodes_stack_.empty()) {
+        if (IsComplete()) {
             throw std::logic_error("Object complete.");
         }
-        if (!(nodes_stack_.back()->IsDict())) {
+        if (!InDict()) {
             throw std::logic_error("Not in Dict context.");
         }
         if (key_.has_value()) {
@@ -103,6 +137,11 @@ namespace json {
     }
 
     GenericContext Builder::Value(Node::Value val) {
+        if (writer_ != nullptr) {
+            StartWrittenItem();
+            writer_->Value(val);
+            return {this};
+        }
         if (!started_) {
             started_ = true;
             std::visit([this](auto&& arg){this->root_ = arg;}, val);
@@ -127,6 +166,12 @@ namespace json {
     }
 
     DictItemContext Builder::StartDict() {
+        if (writer_ != nullptr) {
+            StartWrittenItem();
+            writer_->StartDict();
+            written_dicts_.push_back(true);
+            return {this};
+        }
         Dict dict;
         Node* node_ptr;
         if (!started_) {
@@ -156,20 +201,31 @@ namespace json {
         if (!started_) {
             throw std::logic_error("Not in Dict context.");
         }
-        if (nodes_stack_.empty()) {
+        if (IsComplete()) {
             throw std::logic_error("Object complete.");
         }
-        if (!(nodes_stack_.back()->IsDict())) {
+        if (!InDict()) {
             throw std::logic_error("Not in Dict context.");
         }
         if (key_.has_value()) {
             throw std::logic_error("Key not resolved.");
         }
-        nodes_stack_.pop_back();
+        if (writer_ != nullptr) {
+            writer_->EndDict();
+            written_dicts_.pop_back();
+        } else {
+            nodes_stack_.pop_back();
+        }
         return {this};
     }
 
     ArrayItemContext Builder::StartArray() {
+        if (writer_ != nullptr) {
+            StartWrittenItem();
+            writer_->StartArray();
+            written_dicts_.push_back(false);
+            return {this};
+        }
         Array array;
         Node* node_ptr;
         if (!started_) {
@@ -199,17 +255,25 @@ namespace json {
         if (!started_) {
             throw std::logic_error("Not in Array context.");
         }
-        if (nodes_stack_.empty()) {
+        if (IsComplete()) {
             throw std::logic_error("Object complete.");
         }
-        if (!(nodes_stack_.back()->IsArray())) {
+        if (!InArray()) {
             throw std::logic_error("Not in Array context.");
         }
-        nodes_stack_.pop_back();
+        if (writer_ != nullptr) {
+            writer_->EndArray();
+            written_dicts_.pop_back();
+        } else {
+            nodes_stack_.pop_back();
+        }
         return {this};
     }
 
     Node Builder::Build() {
+        if (writer_ != nullptr) {
+            throw std::logic_error("Document has been written, not built.");
+        }
         if (!started_) {
             throw std::logic_error("Document has not been built at all.");
         }
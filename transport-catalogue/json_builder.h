@@ -64,8 +64,13 @@ namespace json {
 
     class Builder {
     public:
+        // Builds the document as a tree of nodes, returned by Build()
         Builder() = default;
 
+        // Writes the document straight to the writer without making nodes, as the next value of
+        // the writer. The same calls are allowed and checked, but there is nothing to Build()
+        explicit Builder(Writer& writer);
+
         KeyContext Key(const std::string& key);
         GenericContext Value(Node::Value val);
 
@@ -77,9 +82,18 @@ namespace json {
 
         Node Build();
     private:
+        bool IsComplete() const;
+        bool InDict() const;
+        bool InArray() const;
+        void StartWrittenItem();
+
         bool started_ = false;
         Node root_;
         std::vector<Node*> nodes_stack_;
         std::optional<std::string> key_;
+
+        Writer* writer_ = nullptr;
+        // Whether each of the containers open in the writer is a dict, the innermost last
+        std::vector<bool> written_dicts_;
     };
 }
@@ -1,7 +1,17 @@
 #include "json_reader.h"
 
+#include "bidirectional_dijkstra_router.h"
+#include "contraction_hierarchy.h"
+#include "dijkstra_router.h"
+#include "mapped_file.h"
+#include "router_storage.h"
+#include "spt_cache_router.h"
+
 #include <algorithm>
 #include <iostream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
 #include <string>
 #include <variant>
 #include <vector>
@@ -10,52 +20,235 @@
 
 namespace json_reader {
     void ProcessInput(std::istream& istream, std::ostream& ostream, transport_catalogue::TransportCatalogue& tc) {
-        const auto doc = json::Load(istream);
-        json::Dict root = doc.GetRoot().AsMap();
+        json::Reader reader(istream);
+        ProcessRequests(reader, ostream, tc);
+    }
+
+    void ProcessInputFile(const std::string& path, std::ostream& ostream, transport_catalogue::TransportCatalogue& tc) {
+        const mapped_file::MappedFile file(path);
+        json::Reader reader(std::string_view(file.Data(), file.Size()));
+        ProcessRequests(reader, ostream, tc);
+    }
+
+    void ProcessRequests(json::Reader& reader, std::ostream& ostream, transport_catalogue::TransportCatalogue& tc) {
+        BaseRequestLoader loader(tc);
+        bool has_base_requests = false;
+        std::optional<json::Node> render_settings;
+        std::optional<json::Node> routing_settings;
+        // Stat requests are answered as they are read once the base requests and the settings are known.
+        // Those which come before any of them wait in memory until the input is read
+        bool has_stat_requests = false;
+        std::vector<json::Node> pending_stat_requests;
+        std::optional<RoutingSettings> settings;
+        std::optional<graph::DirectedWeightedGraph<double>> directed_graph;
+        std::optional<StatRequestProcessor> processor;
+        auto start_answering = [&]() {
+            loader.Finish();
+            settings = ProcessRouting(*routing_settings);
+            directed_graph.emplace(BuildGraph(tc, *settings));
+            processor.emplace(tc, ProcessRender(*render_settings), *directed_graph, *settings, ostream);
+        };
+
+        reader.StartDict();
+        while (const auto key = reader.NextKey()) {
+            if (*key == "base_requests" && !processor) {
+                loader.Load(reader);
+                has_base_requests = true;
+            } else if (*key == "render_settings" && !render_settings) {
+                render_settings = reader.ReadValue();
+            } else if (*key == "routing_settings" && !routing_settings) {
+                routing_settings = reader.ReadValue();
+            } else if (*key == "stat_requests" && !has_stat_requests) {
+                has_stat_requests = true;
+                if (has_base_requests && render_settings && routing_settings) {
+                    start_answering();
+                }
+                reader.StartArray();
+                while (reader.NextElement()) {
+                    if (processor) {
+                        processor->Process(reader.ReadValue());
+                    } else {
+                        pending_stat_requests.push_back(reader.ReadValue());
+                    }
+                }
+            } else {
+                reader.SkipValue();
+            }
+        }
+        if (!render_settings || !routing_settings || !has_stat_requests) {
+            throw std::out_of_range("Input has no settings or stat requests");
+        }
+        if (!processor) {
+            start_answering();
+        }
+        for (const auto& request : pending_stat_requests) {
+            processor->Process(request);
+        }
+        processor->Finish();
+    }
+
+    void ProcessDocument(const json::Document& doc, std::ostream& ostream, transport_catalogue::TransportCatalogue& tc) {
+        const json::Dict& root = doc.GetRoot().AsMap();
         auto map_settings = ProcessRender(root.at("render_settings"));
         auto routing_settings = ProcessRouting(root.at("routing_settings"));
         auto directed_graph = ProcessBaseRequests(root.at("base_requests"), tc, routing_settings);
-        ProcessStatRequests(root.at("stat_requests"), tc, map_settings, ostream, directed_graph);
+        ProcessStatRequests(root.at("stat_requests"), tc, map_settings, ostream, directed_graph, routing_settings);
     }
 
     graph::DirectedWeightedGraph<double> ProcessBaseRequests(
-        json::Node& requests_node,
+        const json::Node& requests_node,
         transport_catalogue::TransportCatalogue& tc,
         RoutingSettings& routing_settings
     ) {
-        json::Array requests = requests_node.AsArray();
-        size_t vertex_id = 0;
-        for (auto req : requests) {
-            auto map = req.AsMap();
-            if (map.at("type").AsString() == "Stop") {
-                AddStop(map, tc, vertex_id);
-                vertex_id += 2;
+        // Requests are read in place, distances and buses wait for all stops by reference
+        std::vector<const json::Dict*> stops;
+        std::vector<const json::Dict*> buses;
+        for (const auto& request_node : requests_node.AsArray()) {
+            const auto& request = request_node.AsMap();
+            const auto type = request.at("type").AsString();
+            if (type == "Stop") {
+                AddStop(request, tc);
+                stops.push_back(&request);
+            } else if (type == "Bus") {
+                buses.push_back(&request);
             }
         }
 
-        graph::DirectedWeightedGraph<double> directed_graph(vertex_id);
+        graph::DirectedWeightedGraph<double> directed_graph(2 * tc.GetStopCount());
+
+        for (const json::Dict* stop : stops) {
+            AddDist(*stop, tc, directed_graph, routing_settings);
+        }
+        tc.IndexDistances();
+        for (const json::Dict* bus : buses) {
+            AddBus(*bus, tc, directed_graph, routing_settings);
+        }
+        directed_graph.Freeze();
+        return directed_graph;
+    }
+
+    BaseRequestLoader::BaseRequestLoader(transport_catalogue::TransportCatalogue& tc)
+        : tc_(tc) {
+    }
+
+    void BaseRequestLoader::Load(json::Reader& reader) {
+        reader.StartArray();
+        while (reader.NextElement()) {
+            LoadRequest(reader);
+        }
+    }
+
+    void BaseRequestLoader::LoadRequest(json::Reader& reader) {
+        type_.clear();
+        name_.clear();
+        latitude_ = 0.;
+        longitude_ = 0.;
+        is_roundtrip_ = false;
+        // Distances and stop names are made pending as they are read, as the type may come
+        // after them, and dropped if the request turns out to be of another type
+        const size_t first_distance = pending_distances_.size();
+        const size_t first_stop = pending_stop_names_.size();
+
+        reader.StartDict();
+        while (const auto key = reader.NextKey()) {
+            if (*key == "type") {
+                type_ = reader.ReadString();
+            } else if (*key == "name") {
+                name_ = reader.ReadString();
+            } else if (*key == "latitude") {
+                latitude_ = reader.ReadDouble();
+            } else if (*key == "longitude") {
+                longitude_ = reader.ReadDouble();
+            } else if (*key == "road_distances") {
+                reader.StartDict();
+                while (const auto to_name = reader.NextKey()) {
+                    const NameRef to = AddName(*to_name);
+                    pending_distances_.push_back({transport_catalogue::NO_STOP, to, reader.ReadInt()});
+                }
+            } else if (*key == "stops") {
+                reader.StartArray();
+                while (reader.NextElement()) {
+                    pending_stop_names_.push_back(AddName(reader.ReadString()));
+                }
+            } else if (*key == "is_roundtrip") {
+                is_roundtrip_ = reader.ReadBool();
+            } else {
+                reader.SkipValue();
+            }
+        }
 
-        for (auto req : requests) {
-            auto map = req.AsMap();
-            if (map.at("type").AsString() == "Stop") {
-                AddDist(map, tc, directed_graph, routing_settings);
+        if (type_ == "Stop") {
+            // The name isn't needed after the stop has been added, so the stop takes it
+            auto stop = tc_.AddStop(std::move(name_), {latitude_, longitude_});
+            for (size_t i = first_distance; i < pending_distances_.size(); ++i) {
+                pending_distances_[i].from = stop;
             }
+            pending_stop_names_.resize(first_stop);
+        } else if (type_ == "Bus") {
+            pending_buses_.push_back({std::move(name_), first_stop, pending_stop_names_.size() - first_stop, is_roundtrip_});
+            pending_distances_.resize(first_distance);
+        } else {
+            pending_distances_.resize(first_distance);
+            pending_stop_names_.resize(first_stop);
+        }
+    }
+
+    BaseRequestLoader::NameRef BaseRequestLoader::AddName(std::string_view name) {
+        const NameRef ref{names_.size(), name.size()};
+        names_.append(name);
+        return ref;
+    }
+
+    std::string_view BaseRequestLoader::GetName(NameRef name) const {
+        return std::string_view(names_).substr(name.offset, name.size);
+    }
+
+    void BaseRequestLoader::Finish() {
+        for (const auto& [from, to, distance] : pending_distances_) {
+            tc_.AddDistance(from, tc_.StopByName(GetName(to)), distance);
         }
-        for (auto req : requests) {
-            auto map = req.AsMap();
-            if (map.at("type").AsString() == "Bus") {
-                AddBus(map, tc, directed_graph, routing_settings);
+        tc_.IndexDistances();
+        std::vector<transport_catalogue::StopId> stops;
+        for (auto& bus : pending_buses_) {
+            stops.clear();
+            for (size_t i = bus.first_stop; i < bus.first_stop + bus.stop_count; ++i) {
+                stops.push_back(tc_.StopByName(GetName(pending_stop_names_[i])));
             }
+            tc_.AddBus(std::move(bus.name), stops, bus.is_roundtrip);
+        }
+        // Assigning {} would only clear them and keep their memory
+        pending_distances_.clear();
+        pending_distances_.shrink_to_fit();
+        pending_buses_.clear();
+        pending_buses_.shrink_to_fit();
+        pending_stop_names_.clear();
+        pending_stop_names_.shrink_to_fit();
+        names_.clear();
+        names_.shrink_to_fit();
+    }
+
+    graph::DirectedWeightedGraph<double> BuildGraph(
+        transport_catalogue::TransportCatalogue& tc,
+        RoutingSettings& routing_settings
+    ) {
+        graph::DirectedWeightedGraph<double> directed_graph(2 * tc.GetStopCount());
+        for (transport_catalogue::StopId stop = 0; stop < tc.GetStopCount(); ++stop) {
+            directed_graph.AddEdge({
+                transport_catalogue::TransportCatalogue::GetInVertex(stop),
+                transport_catalogue::TransportCatalogue::GetOutVertex(stop),
+                static_cast<double>(routing_settings.bus_wait_time)
+            });
+        }
+        for (transport_catalogue::BusId bus = 0; bus < tc.GetBusCount(); ++bus) {
+            AddBusEdges(bus, tc, directed_graph, routing_settings);
         }
+        directed_graph.Freeze();
         return directed_graph;
     }
 
-    void AddStop(const json::Dict& stop, transport_catalogue::TransportCatalogue& tc, size_t vertex_id) {
-        std::string name = stop.at("name").AsString();
-        tc.AddStop({name,
-                    stop.at("latitude").AsDouble(),
-                    stop.at("longitude").AsDouble(),
-                    vertex_id});
+    void AddStop(const json::Dict& stop, transport_catalogue::TransportCatalogue& tc) {
+        tc.AddStop(std::string(stop.at("name").AsString()),
+                   {stop.at("latitude").AsDouble(), stop.at("longitude").AsDouble()});
     }
 
     void AddDist(
@@ -64,11 +257,14 @@ namespace json_reader {
         graph::DirectedWeightedGraph<double>& directed_graph,
         RoutingSettings& routing_settings
     ) {
-        auto dists = stop.at("road_distances").AsMap();
-        std::string name = stop.at("name").AsString();
-        auto this_stop = tc.StopByName(name);
-        directed_graph.AddEdge({this_stop->in_vertex, this_stop->out_vertex, static_cast<double>(routing_settings.bus_wait_time)});
-        for (auto [to_name, dist_node] : dists) {
+        const auto& dists = stop.at("road_distances").AsMap();
+        auto this_stop = tc.StopByName(stop.at("name").AsString());
+        directed_graph.AddEdge({
+            transport_catalogue::TransportCatalogue::GetInVertex(this_stop),
+            transport_catalogue::TransportCatalogue::GetOutVertex(this_stop),
+            static_cast<double>(routing_settings.bus_wait_time)
+        });
+        for (const auto& [to_name, dist_node] : dists) {
             auto to_stop = tc.StopByName(to_name);
             tc.AddDistance(this_stop, to_stop, dist_node.AsInt());
         }
@@ -80,151 +276,437 @@ namespace json_reader {
         graph::DirectedWeightedGraph<double>& directed_graph,
         RoutingSettings& routing_settings
     ) {
-        std::string name = bus.at("name").AsString();
-        std::vector<transport_catalogue::Stop*> stops;
-
-        auto stop_names = bus.at("stops").AsArray();
-        for (auto stop_name : stop_names) {
+        std::vector<transport_catalogue::StopId> stops;
+        for (const auto& stop_name : bus.at("stops").AsArray()) {
             stops.push_back(tc.StopByName(stop_name.AsString()));
         }
-        transport_catalogue::Stop* first = stops[0];
-        transport_catalogue::Stop* last = stops[stops.size() - 1];
+        auto tc_bus = tc.AddBus(std::string(bus.at("name").AsString()), stops, bus.at("is_roundtrip").AsBool());
+        AddBusEdges(tc_bus, tc, directed_graph, routing_settings);
+    }
 
-        if (!bus.at("is_roundtrip").AsBool()) {
-            for (int i=stop_names.size()-2;i>=0;--i) {
-                stops.push_back(tc.StopByName(stop_names[i].AsString()));
-            }
+    void AddBusEdges(
+        transport_catalogue::BusId bus,
+        transport_catalogue::TransportCatalogue& tc,
+        graph::DirectedWeightedGraph<double>& directed_graph,
+        RoutingSettings& routing_settings
+    ) {
+        switch (routing_settings.graph_model) {
+            case GraphModel::STOP_PAIRS:
+                AddBusStopPairs(bus, tc, directed_graph, routing_settings);
+                break;
+            case GraphModel::ROUTE_PATTERN:
+                AddBusRoutePattern(bus, tc, directed_graph, routing_settings);
+                break;
         }
-        auto tc_bus = tc.AddBus({name, stops, tc.GetDists(), bus.at("is_roundtrip").AsBool(), first, last});
+    }
 
-        // Add edges to the graph
+    void AddBusStopPairs(
+        transport_catalogue::BusId bus,
+        transport_catalogue::TransportCatalogue& tc,
+        graph::DirectedWeightedGraph<double>& directed_graph,
+        RoutingSettings& routing_settings
+    ) {
+        const auto stops = tc.GetBusStops(bus);
+        // Every segment is ridden by all the trips over it, so its distance is looked up once
+        std::vector<int> segment_dists;
+        segment_dists.reserve(tc.GetBusStopCount(bus));
+        for (auto it = stops.begin(); it != stops.end() && next(it) != stops.end(); ++it) {
+            segment_dists.push_back(tc.GetDistance(*it, *next(it)));
+        }
         for (auto slow_it = stops.begin(); slow_it != stops.end(); ++slow_it) {
             int total_dist = 0;
             for (auto fast_it = next(slow_it); fast_it != stops.end(); ++fast_it) {
-                auto itr = tc.GetDists()->find({*prev(fast_it), *fast_it});
-                if (itr != tc.GetDists()->end()) {
-                    total_dist += itr->second;
-                } else {
-                    total_dist += tc.GetDists()->at({*fast_it, *prev(fast_it)});
-                }
+                total_dist += segment_dists[prev(fast_it) - stops.begin()];
                 auto edge = directed_graph.AddEdge({
-                    (*slow_it)->out_vertex,
-                    (*fast_it)->in_vertex,
+                    transport_catalogue::TransportCatalogue::GetOutVertex(*slow_it),
+                    transport_catalogue::TransportCatalogue::GetInVertex(*fast_it),
                     total_dist / routing_settings.bus_velocity
                 });
-                tc.AddEdgeSpanToBus(edge, tc_bus, (fast_it - slow_it));
+                tc.AddEdgeSpanToBus(edge, bus, (fast_it - slow_it));
+            }
+        }
+    }
+
+    void AddBusRoutePattern(
+        transport_catalogue::BusId bus,
+        transport_catalogue::TransportCatalogue& tc,
+        graph::DirectedWeightedGraph<double>& directed_graph,
+        RoutingSettings& routing_settings
+    ) {
+        const auto route = tc.GetBusStops(bus);
+        const std::vector<transport_catalogue::StopId> stops(route.begin(), route.end());
+        // Every position of the bus gets its own vertex. A trip boards at one position,
+        // rides along the following ones and alights, so the route items are restored
+        // by merging consecutive edges of the bus (boarding and alighting have zero span).
+        std::vector<graph::VertexId> positions;
+        positions.reserve(stops.size());
+        for (size_t i = 0; i < stops.size(); ++i) {
+            positions.push_back(directed_graph.AddVertex());
+        }
+        for (size_t i = 0; i < stops.size(); ++i) {
+            if (i + 1 < stops.size()) {
+                auto board = directed_graph.AddEdge({
+                    transport_catalogue::TransportCatalogue::GetOutVertex(stops[i]),
+                    positions[i],
+                    0.
+                });
+                tc.AddEdgeSpanToBus(board, bus, 0);
+                auto ride = directed_graph.AddEdge({
+                    positions[i],
+                    positions[i + 1],
+                    tc.GetDistance(stops[i], stops[i + 1]) / routing_settings.bus_velocity
+                });
+                tc.AddEdgeSpanToBus(ride, bus, 1);
+            }
+            if (i > 0) {
+                auto alight = directed_graph.AddEdge({
+                    positions[i],
+                    transport_catalogue::TransportCatalogue::GetInVertex(stops[i]),
+                    0.
+                });
+                tc.AddEdgeSpanToBus(alight, bus, 0);
             }
         }
     }
 
     void ProcessStatRequests(
-        json::Node& requests_node,
+        const json::Node& requests_node,
         transport_catalogue::TransportCatalogue& tc,
         map_renderer::MapSettings& map_settings,
         std::ostream& ostream,
-        graph::DirectedWeightedGraph<double>& directed_graph
+        graph::DirectedWeightedGraph<double>& directed_graph,
+        RoutingSettings& routing_settings
+    ) {
+        StatRequestProcessor processor(tc, map_settings, directed_graph, routing_settings, ostream);
+        for (const auto& request : requests_node.AsArray()) {
+            processor.Process(request);
+        }
+        processor.Finish();
+    }
+
+    StatRequestProcessor::StatRequestProcessor(
+        transport_catalogue::TransportCatalogue& tc,
+        const map_renderer::MapSettings& map_settings,
+        const graph::DirectedWeightedGraph<double>& directed_graph,
+        const RoutingSettings& routing_settings,
+        std::ostream& ostream
+    ) :
+        tc_(tc),
+        map_settings_(map_settings),
+        renderer_(map_settings_),
+        router_(MakeRouter(directed_graph, tc, routing_settings)),
+        handler_(tc, renderer_, directed_graph, *router_),
+        responces_(ostream, print_settings_)
+    {
+        // Base requests are all added by now
+        tc.IndexBusesByStop();
+        responces_.StartArray();
+    }
+
+    void StatRequestProcessor::Process(const json::Node& request_node) {
+        const auto& request = request_node.AsMap();
+        const auto fragment = fragments_ ? fragments_->Find(request) : std::nullopt;
+        if (fragment) {
+            responces_.StartDict();
+            responces_.Splice(fragment->before_request_id);
+            responces_.Key("request_id");
+            responces_.Value(request.at("id").AsInt());
+            responces_.Splice(fragment->after_request_id);
+            responces_.EndDict();
+        } else {
+            json::Builder resp(responces_);
+            ProcessStatRequest(request_node, resp, handler_);
+            const auto type = request.at("type").AsString();
+            if (type == "Bus" || type == "Stop") {
+                ++bus_and_stop_requests_;
+                if (ResponseFragments::IsWorthBuilding(bus_and_stop_requests_, tc_)) {
+                    fragments_.emplace(tc_, handler_, print_settings_);
+                }
+            }
+        }
+        // Every answer is written out as soon as it is ready
+        responces_.Flush();
+    }
+
+    void StatRequestProcessor::Finish() {
+        responces_.EndArray();
+        responces_.Flush();
+        router_->PrintStats(std::cerr);
+    }
+
+    ResponseFragments::ResponseFragments(
+        const transport_catalogue::TransportCatalogue& tc,
+        request_handler::RequestHandler& handler,
+        const json::PrintSettings& settings
+    ) :
+        tc_(tc)
+    {
+        // Every answer is written whole after the previous one, as in the array of responses,
+        // and what comes before and after its request id is kept
+        std::ostringstream output;
+        json::Writer writer(output, settings, 1);
+        auto add_fragment = [this, &output, &writer, &handler](auto process_request, std::string_view name) {
+            json::Builder resp(writer);
+            resp.StartDict();
+            writer.Flush();
+            output.str({});
+            size_t before_end = 0;
+            size_t after_begin = 0;
+            process_request(name, resp, handler, [&]() {
+                writer.Flush();
+                before_end = static_cast<size_t>(output.tellp());
+                resp.Key(static_cast<std::string>("request_id")).Value(0);
+                writer.Flush();
+                after_begin = static_cast<size_t>(output.tellp());
+            });
+            writer.Flush();
+            fragments_.append(output.view().substr(0, before_end));
+            offsets_.push_back(fragments_.size());
+            fragments_.append(output.view().substr(after_begin));
+            offsets_.push_back(fragments_.size());
+            resp.EndDict();
+            writer.Flush();
+            output.str({});
+        };
+        offsets_.push_back(0);
+        for (transport_catalogue::BusId bus = 0; bus < tc.GetBusCount(); ++bus) {
+            add_fragment(ProcessBusRequest, tc.GetBusName(bus));
+        }
+        for (transport_catalogue::StopId stop = 0; stop < tc.GetStopCount(); ++stop) {
+            add_fragment(ProcessStopRequest, tc.GetStopName(stop));
+        }
+    }
+
+    bool ResponseFragments::IsWorthBuilding(size_t bus_and_stop_requests, const transport_catalogue::TransportCatalogue& tc) {
+        return bus_and_stop_requests >= tc.GetBusCount() + tc.GetStopCount();
+    }
+
+    std::optional<ResponseFragments::Fragment> ResponseFragments::Find(const json::Dict& request) const {
+        const auto type = request.at("type").AsString();
+        size_t index = 0;
+        if (type == "Bus") {
+            index = tc_.FindBus(request.at("name").AsString());
+            if (index == transport_catalogue::NO_BUS) {
+                return std::nullopt;
+            }
+        } else if (type == "Stop") {
+            const transport_catalogue::StopId stop = tc_.FindStop(request.at("name").AsString());
+            if (stop == transport_catalogue::NO_STOP) {
+                return std::nullopt;
+            }
+            index = tc_.GetBusCount() + stop;
+        } else {
+            return std::nullopt;
+        }
+        const std::string_view fragments(fragments_);
+        const size_t begin = offsets_[2 * index];
+        const size_t middle = offsets_[2 * index + 1];
+        const size_t end = offsets_[2 * index + 2];
+        return Fragment{fragments.substr(begin, middle - begin), fragments.substr(middle, end - middle)};
+    }
+
+    std::unique_ptr<graph::RouterInterface<double>> MakeRouter(
+        const graph::DirectedWeightedGraph<double>& directed_graph,
+        const transport_catalogue::TransportCatalogue& tc,
+        const RoutingSettings& routing_settings
+    ) {
+        switch (routing_settings.router_type) {
+            case RouterType::DIJKSTRA:
+                return std::make_unique<graph::DijkstraRouter<double>>(directed_graph);
+            case RouterType::CONTRACTION_HIERARCHY:
+                return std::make_unique<graph::ContractionHierarchy<double>>(directed_graph);
+            case RouterType::BIDIRECTIONAL_DIJKSTRA:
+                return std::make_unique<graph::BidirectionalDijkstraRouter<double>>(directed_graph);
+            case RouterType::SPT_CACHE:
+                return std::make_unique<graph::SptCacheRouter<double>>(
+                    directed_graph,
+                    routing_settings.spt_cache_megabytes * 1024 * 1024
+                );
+            case RouterType::ASTAR: {
+                auto coordinates = GetVertexCoordinates(directed_graph, tc);
+                return std::make_unique<graph::AStarRouter<double>>(
+                    directed_graph,
+                    routing_settings.landmark_count,
+                    [coordinates = std::move(coordinates)](graph::VertexId from, graph::VertexId to) {
+                        return geo::ComputeDistance(coordinates[from], coordinates[to]);
+                    }
+                );
+            }
+            case RouterType::FLOYD_WARSHALL:
+                break;
+        }
+        if (routing_settings.router_tables_file.empty()) {
+            return std::make_unique<graph::Router<double>>(directed_graph);
+        }
+        const auto checksum = router_storage::ComputeChecksum(directed_graph, tc);
+        if (auto mapped_router = router_storage::LoadRouter(routing_settings.router_tables_file, checksum, directed_graph)) {
+            return mapped_router;
+        }
+        auto router = std::make_unique<graph::Router<double>>(directed_graph);
+        // The file only spares the next run the computation, so this one goes on without it
+        if (!router_storage::SaveRouter(routing_settings.router_tables_file, checksum, directed_graph, tc, *router)) {
+            std::cerr << "Can't write router tables to " << routing_settings.router_tables_file << std::endl;
+        }
+        return router;
+    }
+
+    std::vector<geo::Coordinates> GetVertexCoordinates(
+        const graph::DirectedWeightedGraph<double>& directed_graph,
+        const transport_catalogue::TransportCatalogue& tc
     ) {
-        json::Array requests = requests_node.AsArray();
-        json::Builder responces;
-        responces.StartArray();
-        map_renderer::MapRenderer mr {map_settings};
-        graph::Router router(directed_graph);
-        request_handler::RequestHandler handler(tc, mr, directed_graph, router);
-        for (auto req : requests) {
-            responces.Value(ProcessStatRequest(req, handler).GetValue());
-        }
-        responces.EndArray();
-        json::Print(json::Document{responces.Build()}, ostream);
-    }
-
-    json::Node ProcessStatRequest(json::Node& request_node, request_handler::RequestHandler& handler) {
-        auto request = request_node.AsMap();
-        json::Builder resp;
+        std::vector<transport_catalogue::StopId> stops(directed_graph.GetVertexCount(), transport_catalogue::NO_STOP);
+        for (size_t vertex = 0; vertex < stops.size(); ++vertex) {
+            stops[vertex] = tc.StopByVertex(vertex);
+        }
+        // Route pattern vertices are tied to their stops by boarding and alighting edges
+        for (graph::EdgeId edge_id = 0; edge_id < directed_graph.GetEdgeCount(); ++edge_id) {
+            const auto& edge = directed_graph.GetEdge(edge_id);
+            const bool from_stop = tc.StopByVertex(edge.from) != transport_catalogue::NO_STOP;
+            const bool to_stop = tc.StopByVertex(edge.to) != transport_catalogue::NO_STOP;
+            if (from_stop && !to_stop) {
+                stops[edge.to] = stops[edge.from];
+            } else if (to_stop && !from_stop) {
+                stops[edge.from] = stops[edge.to];
+            }
+        }
+        std::vector<geo::Coordinates> coordinates(directed_graph.GetVertexCount(), {0., 0.});
+        for (size_t vertex = 0; vertex < stops.size(); ++vertex) {
+            if (stops[vertex] != transport_catalogue::NO_STOP) {
+                coordinates[vertex] = tc.GetStopCoordinates(stops[vertex]);
+            }
+        }
+        return coordinates;
+    }
+
+    void ProcessStatRequest(const json::Node& request_node, json::Builder& resp, request_handler::RequestHandler& handler) {
+        const auto& request = request_node.AsMap();
+        const int request_id = request.at("id").AsInt();
+        const RequestIdWriter write_request_id = [&resp, request_id]() {
+            resp.Key(static_cast<std::string>("request_id")).Value(request_id);
+        };
         resp.StartDict();
-        resp.Key(static_cast<std::string>("request_id")).Value(request.at("id").AsInt());
-        std::string req_type = request.at("type").AsString();
+        std::string_view req_type = request.at("type").AsString();
         if (req_type == "Stop") {
-            ProcessStopRequest(request, resp, handler);
+            ProcessStopRequest(request.at("name").AsString(), resp, handler, write_request_id);
         } else if (req_type == "Bus") {
-            ProcessBusRequest(request, resp, handler);
+            ProcessBusRequest(request.at("name").AsString(), resp, handler, write_request_id);
         } else if (req_type == "Map") {
-            ProcessMapRequest(resp, handler);
+            ProcessMapRequest(resp, handler, write_request_id);
         } else if (req_type == "Route") {
-            ProcessRouteRequest(request, resp, handler);
+            ProcessRouteRequest(request, resp, handler, write_request_id);
+        } else if (req_type == "Matrix") {
+            ProcessMatrixRequest(request, resp, handler, write_request_id);
+        } else {
+            write_request_id();
         }
 
         resp.EndDict();
-        return resp.Build();
     }
 
-    void ProcessStopRequest(json::Dict& request_node, json::Builder& responce_node, request_handler::RequestHandler& handler) {
-        const std::unordered_set<transport_catalogue::Bus*>* buses = handler.GetBusesByStop(request_node.at("name").AsString());
-        if (buses == nullptr) {
-            responce_node.Key(static_cast<std::string>("error_message")).Value(static_cast<std::string>("not found"));
+    void ProcessNotFound(json::Builder& responce_node, const RequestIdWriter& write_request_id) {
+        responce_node.Key(static_cast<std::string>("error_message")).Value(static_cast<std::string>("not found"));
+        write_request_id();
+    }
+
+    void ProcessStopRequest(std::string_view stop_name, json::Builder& responce_node, request_handler::RequestHandler& handler,
+                            const RequestIdWriter& write_request_id) {
+        const auto buses = handler.GetBusesByStop(stop_name);
+        if (!buses) {
+            ProcessNotFound(responce_node, write_request_id);
             return;
         }
-        std::vector<std::string> bus_names;
-        for (transport_catalogue::Bus* bus : *buses) {
-            bus_names.push_back(bus->name);
-        }
-        std::sort(bus_names.begin(), bus_names.end());
+        // Buses come ordered by name, and the names are borrowed from the catalogue
         responce_node.Key(static_cast<std::string>("buses")).StartArray();
-        for (auto bus : bus_names) {
-            responce_node.Value(bus);
+        for (transport_catalogue::BusId bus : *buses) {
+            responce_node.Value(json::String::Borrow(handler.GetBusName(bus)));
         }
         responce_node.EndArray();
+        write_request_id();
     }
 
-    void ProcessBusRequest(json::Dict& request_node, json::Builder& responce_node, request_handler::RequestHandler& handler) {
-        auto bus_stat = handler.GetBusStat(request_node.at("name").AsString());
+    void ProcessBusRequest(std::string_view bus_name, json::Builder& responce_node, request_handler::RequestHandler& handler,
+                           const RequestIdWriter& write_request_id) {
+        auto bus_stat = handler.GetBusStat(bus_name);
         if (!bus_stat) {
-            responce_node.Key(static_cast<std::string>("error_message")).Value(static_cast<std::string>("not found"));
+            ProcessNotFound(responce_node, write_request_id);
             return;
         }
         responce_node.Key(static_cast<std::string>("curvature")).Value(bus_stat->curvature);
+        write_request_id();
         responce_node.Key(static_cast<std::string>("route_length")).Value(bus_stat->route_length);
         responce_node.Key(static_cast<std::string>("stop_count")).Value(bus_stat->stop_count);
         responce_node.Key(static_cast<std::string>("unique_stop_count")).Value(bus_stat->unique_stop_count);
     }
 
-    void ProcessMapRequest(json::Builder& responce_node, request_handler::RequestHandler& handler) {
+    void ProcessMapRequest(json::Builder& responce_node, request_handler::RequestHandler& handler,
+                           const RequestIdWriter& write_request_id) {
         responce_node.Key(static_cast<std::string>("map")).Value(handler.RenderMap());
+        write_request_id();
     }
 
-    void ProcessRouteRequest(json::Dict& request_node, json::Builder& responce_node, request_handler::RequestHandler& handler) {
+    void ProcessRouteRequest(const json::Dict& request_node, json::Builder& responce_node, request_handler::RequestHandler& handler,
+                             const RequestIdWriter& write_request_id) {
         auto route_info = handler.RouteInfo(request_node.at("from").AsString(), request_node.at("to").AsString());
         if (!route_info.has_value()) {
-            responce_node.Key(static_cast<std::string>("error_message")).Value(static_cast<std::string>("not found"));
+            ProcessNotFound(responce_node, write_request_id);
             return;
         }
-        responce_node.Key(static_cast<std::string>("total_time")).Value(route_info->weight);
-
         responce_node.Key(static_cast<std::string>("items")).StartArray();
-        for (auto edge_id : route_info->edges) {
+        for (const auto& item : handler.RouteItems(*route_info)) {
             responce_node.StartDict();
-            auto edge = handler.GraphEdgeInfo(edge_id);
-            responce_node.Key(static_cast<std::string>("time")).Value(edge.weight);
-            auto from_stop = handler.StopByVertex(edge.from);
-            auto to_stop = handler.StopByVertex(edge.to);
-            if (from_stop == to_stop) {
+            if (item.bus == transport_catalogue::NO_BUS) {
+                responce_node.Key(static_cast<std::string>("stop_name")).Value(json::String(handler.GetStopName(item.stop)));
+                responce_node.Key(static_cast<std::string>("time")).Value(item.time);
                 responce_node.Key(static_cast<std::string>("type")).Value(static_cast<std::string>("Wait"));
-                responce_node.Key(static_cast<std::string>("stop_name")).Value(from_stop->name);
             } else {
+                responce_node.Key(static_cast<std::string>("bus")).Value(json::String(handler.GetBusName(item.bus)));
+                responce_node.Key(static_cast<std::string>("span_count")).Value(item.span_count);
+                responce_node.Key(static_cast<std::string>("time")).Value(item.time);
                 responce_node.Key(static_cast<std::string>("type")).Value(static_cast<std::string>("Bus"));
-                auto [bus, span] = handler.BusSpanByEdge(edge_id);
-                responce_node.Key(static_cast<std::string>("bus")).Value(bus->name);
-                responce_node.Key(static_cast<std::string>("span_count")).Value(span);
             }
             responce_node.EndDict();
         }
         responce_node.EndArray();
+        write_request_id();
+        responce_node.Key(static_cast<std::string>("total_time")).Value(route_info->weight);
+    }
+
+    void ProcessMatrixRequest(const json::Dict& request_node, json::Builder& responce_node, request_handler::RequestHandler& handler,
+                              const RequestIdWriter& write_request_id) {
+        auto stop_names = [&request_node](const std::string& key) {
+            std::vector<std::string_view> names;
+            for (const auto& name_node : request_node.at(key).AsArray()) {
+                names.push_back(name_node.AsString());
+            }
+            return names;
+        };
+        auto matrix = handler.TravelTimeMatrix(stop_names("from"), stop_names("to"));
+        if (!matrix) {
+            ProcessNotFound(responce_node, write_request_id);
+            return;
+        }
+        write_request_id();
+        // Rows follow "from" stops, columns follow "to" stops, null for unreachable pairs
+        responce_node.Key(static_cast<std::string>("total_times")).StartArray();
+        for (const auto& row : *matrix) {
+            responce_node.StartArray();
+            for (const auto& total_time : row) {
+                if (total_time) {
+                    responce_node.Value(*total_time);
+                } else {
+                    responce_node.Value(nullptr);
+                }
+            }
+            responce_node.EndArray();
+        }
+        responce_node.EndArray();
     }
 
-    map_renderer::MapSettings ProcessRender(json::Node& requests_node) {
-        json::Dict request = requests_node.AsMap();
+    map_renderer::MapSettings ProcessRender(const json::Node& requests_node) {
+        const json::Dict& request = requests_node.AsMap();
         svg::Color underlayer_color = GetColor(request.at("underlayer_color"));
         std::vector<svg::Color> color_palette;
-        for (json::Node node : request.at("color_palette").AsArray()) {
+        for (const json::Node& node : request.at("color_palette").AsArray()) {
             color_palette.push_back(GetColor(node));
         }
         map_renderer::MapSettings settings{
@@ -250,20 +732,83 @@ namespace json_reader {
         return settings;
     }
 
-    RoutingSettings ProcessRouting(json::Node& requests_node) {
-        json::Dict request = requests_node.AsMap();
-        return {
+    RoutingSettings ProcessRouting(const json::Node& requests_node) {
+        const json::Dict& request = requests_node.AsMap();
+        RoutingSettings settings{
             request.at("bus_wait_time").AsInt(),
             request.at("bus_velocity").AsDouble() * 1000 / 60. // We want meters per minute
         };
+        if (auto it = request.find("router"); it != request.end()) {
+            settings.router_type = GetRouterType(it->second.AsString());
+        }
+        if (auto it = request.find("graph_model"); it != request.end()) {
+            settings.graph_model = GetGraphModel(it->second.AsString());
+        }
+        if (settings.graph_model == GraphModel::ROUTE_PATTERN) {
+            if (request.count("router") == 0) {
+                settings.router_type = RouterType::DIJKSTRA;
+            } else if (settings.router_type == RouterType::FLOYD_WARSHALL) {
+                throw std::invalid_argument("Route pattern graph can't be routed with floyd_warshall");
+            }
+        }
+        if (auto it = request.find("router_tables_file"); it != request.end()) {
+            settings.router_tables_file = std::string(it->second.AsString());
+        }
+        if (auto it = request.find("landmark_count"); it != request.end()) {
+            settings.landmark_count = GetCount(it->second, "landmark_count");
+        }
+        if (auto it = request.find("spt_cache_megabytes"); it != request.end()) {
+            settings.spt_cache_megabytes = GetCount(it->second, "spt_cache_megabytes");
+        }
+        return settings;
+    }
+
+    size_t GetCount(const json::Node& count_node, std::string_view name) {
+        const int count = count_node.AsInt();
+        if (count < 0) {
+            throw std::invalid_argument("Negative " + std::string(name) + ": " + std::to_string(count));
+        }
+        return static_cast<size_t>(count);
+    }
+
+    RouterType GetRouterType(std::string_view router_name) {
+        if (router_name == "floyd_warshall") {
+            return RouterType::FLOYD_WARSHALL;
+        }
+        if (router_name == "dijkstra") {
+            return RouterType::DIJKSTRA;
+        }
+        if (router_name == "contraction_hierarchy") {
+            return RouterType::CONTRACTION_HIERARCHY;
+        }
+        if (router_name == "bidirectional_dijkstra") {
+            return RouterType::BIDIRECTIONAL_DIJKSTRA;
+        }
+        if (router_name == "spt_cache") {
+            return RouterType::SPT_CACHE;
+        }
+        if (router_name == "astar") {
+            return RouterType::ASTAR;
+        }
+        throw std::invalid_argument("Unknown router type: " + std::string(router_name));
+    }
+
+    GraphModel GetGraphModel(std::string_view model_name) {
+        if (model_name == "stop_pairs") {
+            return GraphModel::STOP_PAIRS;
+        }
+        if (model_name == "route_pattern") {
+            return GraphModel::ROUTE_PATTERN;
+        }
+        throw std::invalid_argument("Unknown graph model: " + std::string(model_name));
     }
 
-    svg::Color GetColor(json::Node& color_node) {
+    svg::Color GetColor(const json::Node& color_node) {
         if (color_node.IsString()) {
-            return color_node.AsString();
+            return std::string(color_node.AsString());
         }
         if (color_node.IsArray()) {
-            json::Array color_arr = color_node.AsArray();
+            const json::Array& color_arr = color_node.AsArray();
             if (color_arr.size() == 3) {
                 svg::Rgb rgb {
                     static_cast<uint8_t>(color_arr[0].AsInt()),
@@ -1,7 +1,15 @@
 #pragma once
 
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
+#include "astar_router.h"
 #include "graph.h"
 #include "json.h"
 #include "json_builder.h"
@@ -11,20 +19,118 @@
 #include "transport_catalogue.h"
 
 namespace json_reader {
+    enum class RouterType {
+        FLOYD_WARSHALL,
+        DIJKSTRA,
+        CONTRACTION_HIERARCHY,
+        ASTAR,
+        BIDIRECTIONAL_DIJKSTRA,
+        SPT_CACHE,
+    };
+
+    // How buses are represented in the routing graph.
+    // All-pairs tables over the vertices of route patterns would take cubic time and quadratic
+    // memory in the number of stops of all buses, so route patterns default to the dijkstra router
+    // and can't be routed with floyd_warshall
+    enum class GraphModel {
+        // An edge from every stop of a bus to every later stop, O(k^2) edges per bus
+        STOP_PAIRS,
+        // Boarding, riding and alighting edges through a vertex per (bus, stop position), O(k) edges per bus
+        ROUTE_PATTERN,
+    };
+
     struct RoutingSettings {
         int bus_wait_time;
         double bus_velocity;
+        RouterType router_type = RouterType::FLOYD_WARSHALL;
+        GraphModel graph_model = GraphModel::STOP_PAIRS;
+        // If set, all-pairs router tables are mapped from this file or written to it
+        std::string router_tables_file = {};
+        // Landmarks of the A* router, zero leaves only the geographic bound
+        size_t landmark_count = graph::AStarRouter<double>::DEFAULT_LANDMARK_COUNT;
+        // Memory for cached shortest-path trees of the SPT cache router
+        size_t spt_cache_megabytes = 64;
     };
 
+    // The input is read with a pull parser and base requests go straight into the catalogue,
+    // so the input is never in memory as a whole. Stat requests which follow the base requests
+    // and the settings are answered one by one as they are read
     void ProcessInput(std::istream& istream, std::ostream& ostream, transport_catalogue::TransportCatalogue& tc);
 
+    // Same as ProcessInput, but the file is mapped into memory instead of being read through a window
+    void ProcessInputFile(const std::string& path, std::ostream& ostream, transport_catalogue::TransportCatalogue& tc);
+
+    void ProcessRequests(json::Reader& reader, std::ostream& ostream, transport_catalogue::TransportCatalogue& tc);
+
+    void ProcessDocument(const json::Document& doc, std::ostream& ostream, transport_catalogue::TransportCatalogue& tc);
+
+    // Adds base requests to the catalogue as they are read, whatever order their keys come in.
+    // Stops are added at once, distances and buses refer to stops by name, so they are kept
+    // until all stops are known. Names of the stops they refer to are kept one after another
+    // in a single buffer rather than allocated one by one
+    class BaseRequestLoader {
+    public:
+        explicit BaseRequestLoader(transport_catalogue::TransportCatalogue& tc);
+
+        // Reads an array of base requests
+        void Load(json::Reader& reader);
+
+        // Adds the distances and buses, after all base requests have been read
+        void Finish();
+
+    private:
+        // A name in the buffer of pending names
+        struct NameRef {
+            size_t offset;
+            size_t size;
+        };
+
+        struct PendingDistance {
+            transport_catalogue::StopId from;
+            NameRef to;
+            int distance;
+        };
+
+        struct PendingBus {
+            std::string name;
+            // Range of the bus' stop names in pending_stop_names_
+            size_t first_stop;
+            size_t stop_count;
+            bool is_roundtrip;
+        };
+
+        void LoadRequest(json::Reader& reader);
+        NameRef AddName(std::string_view name);
+        std::string_view GetName(NameRef name) const;
+
+        transport_catalogue::TransportCatalogue& tc_;
+        std::vector<PendingDistance> pending_distances_;
+        std::vector<PendingBus> pending_buses_;
+        std::vector<NameRef> pending_stop_names_;
+        std::string names_;
+
+        // Fields of the request being read, reused by all requests
+        std::string type_;
+        std::string name_;
+        double latitude_ = 0.;
+        double longitude_ = 0.;
+        bool is_roundtrip_ = false;
+    };
+
+    // Wait edges of all stops, then edges of all buses, in the order they have been added to the catalogue.
+    // The graph comes frozen, as does the one of ProcessBaseRequests
+    graph::DirectedWeightedGraph<double> BuildGraph(
+        transport_catalogue::TransportCatalogue& tc,
+        RoutingSettings& routing_settings
+    );
+
     graph::DirectedWeightedGraph<double> ProcessBaseRequests(
-        json::Node& requests,
+        const json::Node& requests,
         transport_catalogue::TransportCatalogue& tc,
         RoutingSettings& routing_settings
     );
 
-    void AddStop(const json::Dict& stop, transport_catalogue::TransportCatalogue& tc, size_t vertex_id);
+    void AddStop(const json::Dict& stop, transport_catalogue::TransportCatalogue& tc);
 
     void AddDist(const json::Dict& stop,
                  transport_catalogue::TransportCatalogue& tc,
@@ -38,27 +144,146 @@ namespace json_reader {
                 RoutingSettings& routing_settings
     );
 
+    void AddBusEdges(
+        transport_catalogue::BusId bus,
+        transport_catalogue::TransportCatalogue& tc,
+        graph::DirectedWeightedGraph<double>& directed_graph,
+        RoutingSettings& routing_settings
+    );
+
+    void AddBusStopPairs(
+        transport_catalogue::BusId bus,
+        transport_catalogue::TransportCatalogue& tc,
+        graph::DirectedWeightedGraph<double>& directed_graph,
+        RoutingSettings& routing_settings
+    );
+
+    void AddBusRoutePattern(
+        transport_catalogue::BusId bus,
+        transport_catalogue::TransportCatalogue& tc,
+        graph::DirectedWeightedGraph<double>& directed_graph,
+        RoutingSettings& routing_settings
+    );
+
+    // Answers of Bus and Stop requests depend on the base data only, so they can be serialized
+    // once for every bus and stop, all but the request id. Answering is then a lookup of the name
+    // and splicing of the fragment around the request id. Fragments are written the same way
+    // as the answers, by a writer with the settings of the responses at the depth of their items
+    class ResponseFragments {
+    public:
+        // Keys of an answer come sorted, so its request id goes between the two parts
+        struct Fragment {
+            std::string_view before_request_id;
+            std::string_view after_request_id;
+        };
+
+        ResponseFragments(
+            const transport_catalogue::TransportCatalogue& tc,
+            request_handler::RequestHandler& handler,
+            const json::PrintSettings& settings
+        );
+
+        // Whether serializing all fragments costs no more than the Bus and Stop requests
+        // answered so far, so that it at most doubles the work of answering them
+        static bool IsWorthBuilding(size_t bus_and_stop_requests, const transport_catalogue::TransportCatalogue& tc);
+
+        // std::nullopt for other types of requests and for unknown names
+        std::optional<Fragment> Find(const json::Dict& request) const;
+
+    private:
+        const transport_catalogue::TransportCatalogue& tc_;
+        // Fragments of buses, then fragments of stops, one after another. The fragment of bus
+        // is [offsets_[2 * bus], offsets_[2 * bus + 1]) before the request id and
+        // [offsets_[2 * bus + 1], offsets_[2 * bus + 2]) after it, the fragments of stops follow the buses'
+        std::string fragments_;
+        std::vector<size_t> offsets_;
+    };
+
     void ProcessStatRequests(
-        json::Node& requests_node,
+        const json::Node& requests_node,
         transport_catalogue::TransportCatalogue& tc,
         map_renderer::MapSettings& settings,
         std::ostream& ostream,
-        graph::DirectedWeightedGraph<double>& directed_graph
+        graph::DirectedWeightedGraph<double>& directed_graph,
+        RoutingSettings& routing_settings
     );
 
-    json::Node ProcessStatRequest(json::Node& request_node, request_handler::RequestHandler& handler);
+    // Answers stat requests one by one, each one as soon as it comes, and writes the answers
+    // straight to the output as an array. The catalogue and the graph have to be complete
+    class StatRequestProcessor {
+    public:
+        StatRequestProcessor(
+            transport_catalogue::TransportCatalogue& tc,
+            const map_renderer::MapSettings& map_settings,
+            const graph::DirectedWeightedGraph<double>& directed_graph,
+            const RoutingSettings& routing_settings,
+            std::ostream& ostream
+        );
+
+        void Process(const json::Node& request_node);
+
+        // Closes the array of answers, nothing can be processed after it.
+        // Stats of the router, if it keeps any, go to the standard error stream
+        void Finish();
+
+    private:
+        const transport_catalogue::TransportCatalogue& tc_;
+        map_renderer::MapSettings map_settings_;
+        map_renderer::MapRenderer renderer_;
+        std::unique_ptr<graph::RouterInterface<double>> router_;
+        request_handler::RequestHandler handler_;
+        json::PrintSettings print_settings_;
+        json::Writer responces_;
+        // Built once Bus and Stop requests turn out to be frequent
+        std::optional<ResponseFragments> fragments_;
+        size_t bus_and_stop_requests_ = 0;
+    };
+
+    std::unique_ptr<graph::RouterInterface<double>> MakeRouter(
+        const graph::DirectedWeightedGraph<double>& directed_graph,
+        const transport_catalogue::TransportCatalogue& tc,
+        const RoutingSettings& routing_settings
+    );
+
+    // Coordinates of the stop every vertex belongs to, used as a lower bound by the A* router
+    std::vector<geo::Coordinates> GetVertexCoordinates(
+        const graph::DirectedWeightedGraph<double>& directed_graph,
+        const transport_catalogue::TransportCatalogue& tc
+    );
+
+    // Keys of an answer are written in sorted order, as json::Print orders keys of a dict,
+    // so every kind of answer writes its request id in the place of the key among its own keys
+    using RequestIdWriter = std::function<void()>;
+
+    void ProcessStatRequest(const json::Node& request_node, json::Builder& resp, request_handler::RequestHandler& handler);
+
+    void ProcessNotFound(json::Builder& responce_node, const RequestIdWriter& write_request_id);
+
+    void ProcessStopRequest(std::string_view stop_name, json::Builder& responce_node, request_handler::RequestHandler& handler,
+                            const RequestIdWriter& write_request_id);
+
+    void ProcessBusRequest(std::string_view bus_name, json::Builder& responce_node, request_handler::RequestHandler& handler,
+                           const RequestIdWriter& write_request_id);
+
+    void ProcessMapRequest(json::Builder& responce_node, request_handler::RequestHandler& handler,
+                           const RequestIdWriter& write_request_id);
+
+    void ProcessRouteRequest(const json::Dict& request_node, json::Builder& responce_node, request_handler::RequestHandler& handler,
+                             const RequestIdWriter& write_request_id);
 
-    void ProcessStopRequest(json::Dict& request_node, json::Builder& responce_node, request_handler::RequestHandler& handler);
+    void ProcessMatrixRequest(const json::Dict& request_node, json::Builder& responce_node, request_handler::RequestHandler& handler,
+                              const RequestIdWriter& write_request_id);
 
-    void ProcessBusRequest(json::Dict& request_node, json::Builder& responce_node, request_handler::RequestHandler& handler);
+    map_renderer::MapSettings ProcessRender(const json::Node& requests_node);
 
-    void ProcessMapRequest(json::Builder& responce_node, request_handler::RequestHandler& handler);
+    RoutingSettings ProcessRouting(const json::Node& requests_node);
 
-    void ProcessRouteRequest(json::Dict& request_node, json::Builder& responce_node, request_handler::RequestHandler& handler);
+    RouterType GetRouterType(std::string_view router_name);
 
-    map_renderer::MapSettings ProcessRender(json::Node& requests_node);
+    GraphModel GetGraphModel(std::string_view model_name);
 
-    RoutingSettings ProcessRouting(json::Node& requests_node);
+    // Throws std::invalid_argument for a negative count, named in the message
+    size_t GetCount(const json::Node& count_node, std::string_view name);
 
-    svg::Color GetColor(json::Node& color_node);
+    svg::Color GetColor(const json::Node& color_node);
 }
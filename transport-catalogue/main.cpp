@@ -1,18 +1,29 @@
 #include <iostream>
+#include <string_view>
 
+#include "benchmarks.h"
 #include "json_reader.h"
 
 // Comment these out because practicum's platform doesn't support custom files.
 #include "tests.h"
 // #include "log_duration.h"
 
-int main() {
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string_view(argv[1]) == "--benchmark") {
+        benchmarks::RunBenchmarks(std::cout);
+        return 0;
+    }
+
     tests::RunTests();
     std::cerr << "Tests OK!" << std::endl;
 
     // LOG_DURATION("Test");
     transport_catalogue::TransportCatalogue tc;
-    json_reader::ProcessInput(std::cin, std::cout, tc);
+    if (argc > 2 && std::string_view(argv[1]) == "--input") {
+        json_reader::ProcessInputFile(argv[2], std::cout, tc);
+    } else {
+        json_reader::ProcessInput(std::cin, std::cout, tc);
+    }
 
     std::cerr << "OK!" << std::endl;
 }
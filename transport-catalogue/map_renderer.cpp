@@ -1,6 +1,6 @@
 #include "map_renderer.h"
 
-#include <unordered_set>
+#include <string>
 
 #include <iostream>
 
@@ -54,52 +54,52 @@ namespace map_renderer {
     {}
 
     void MapRenderer::Render(
-        const std::map<std::string_view, transport_catalogue::Bus*>* buses,
-        const std::map<std::string_view, transport_catalogue::Stop*>* stops,
+        const transport_catalogue::TransportCatalogue& tc,
         std::ostream& ostream
     ) const {
-        std::vector<std::string_view> bus_names;
-        std::vector<std::string_view> stop_names;
-        std::unordered_set<transport_catalogue::Stop*> stops_in_routes;
-        for (auto [name, bus] : *buses) {
-            bus_names.push_back(name);
-            auto stops_for_bus = bus->unique_stops;
-            stops_in_routes.merge(stops_for_bus);
+        // Name indexes are ordered by name
+        std::vector<transport_catalogue::BusId> buses;
+        std::vector<bool> is_in_routes(tc.GetStopCount(), false);
+        for (auto [name, bus] : *tc.GetBusnamesPtr()) {
+            buses.push_back(bus);
+            for (transport_catalogue::StopId stop : tc.GetBusStops(bus)) {
+                is_in_routes[stop] = true;
+            }
         }
-        std::sort(bus_names.begin(), bus_names.end());
-        for (auto stop : stops_in_routes) {
-            stop_names.push_back(stop->name);
+        std::vector<transport_catalogue::StopId> stops;
+        for (auto [name, stop] : *tc.GetStopnamesPtr()) {
+            if (is_in_routes[stop]) {
+                stops.push_back(stop);
+            }
         }
-        std::sort(bus_names.begin(), bus_names.end());
-        std::sort(stop_names.begin(), stop_names.end());
 
         std::vector<geo::Coordinates> geo_coords;
-        for (transport_catalogue::Stop* stop : stops_in_routes) {
-            geo_coords.push_back(stop->coords);
+        for (transport_catalogue::StopId stop : stops) {
+            geo_coords.push_back(tc.GetStopCoordinates(stop));
         }
         const SphereProjector proj{
             geo_coords.begin(), geo_coords.end(), settings_.width, settings_.height, settings_.padding
         };
         svg::Document doc;
-        AddLines(buses, doc, bus_names, proj);
-        AddLineTexts(buses, doc, bus_names, proj);
+        AddLines(tc, doc, buses, proj);
+        AddLineTexts(tc, doc, buses, proj);
 
-        AddStops(stops, doc, stop_names, proj);
-        AddStopNames(stops, doc, stop_names, proj);
+        AddStops(tc, doc, stops, proj);
+        AddStopNames(tc, doc, stops, proj);
 
         doc.Render(ostream);
     }
 
     void MapRenderer::AddLines(
-        const std::map<std::string_view, transport_catalogue::Bus*>* buses,
+        const transport_catalogue::TransportCatalogue& tc,
         svg::Document& doc,
-        std::vector<std::string_view>& bus_names,
+        const std::vector<transport_catalogue::BusId>& buses,
         const SphereProjector& proj
     ) const {
-        for (size_t i=0; i<bus_names.size();++i) {
+        for (size_t i=0; i<buses.size();++i) {
             int color_num = i % settings_.color_palette.size();
             svg::Color bus_color = settings_.color_palette[color_num];
-            transport_catalogue::Bus* bus = buses->at(bus_names[i]);
+            transport_catalogue::BusId bus = buses[i];
 
             svg::Polyline poly;
             poly.SetStrokeColor(bus_color)
@@ -107,41 +107,43 @@ namespace map_renderer {
                 .SetFillColor("none")
                 .SetStrokeLineCap(svg::StrokeLineCap::ROUND)
                 .SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
-            for (transport_catalogue::Stop* stop : bus->stops) {
-                poly.AddPoint(proj(stop->coords));
+            for (transport_catalogue::StopId stop : tc.GetBusStops(bus)) {
+                poly.AddPoint(proj(tc.GetStopCoordinates(stop)));
             }
             doc.Add(poly);
         }
     }
 
     void MapRenderer::AddLineTexts(
-        const std::map<std::string_view, transport_catalogue::Bus*>* buses,
+        const transport_catalogue::TransportCatalogue& tc,
         svg::Document& doc,
-        std::vector<std::string_view>& bus_names,
+        const std::vector<transport_catalogue::BusId>& buses,
         const SphereProjector& proj
     ) const {
-        for (size_t i=0; i<bus_names.size();++i) {
+        for (size_t i=0; i<buses.size();++i) {
             int color_num = i % settings_.color_palette.size();
             svg::Color bus_color = settings_.color_palette[color_num];
-            transport_catalogue::Bus* bus = buses->at(bus_names[i]);
+            transport_catalogue::BusId bus = buses[i];
+            transport_catalogue::StopId first = tc.GetBusFirstStop(bus);
+            transport_catalogue::StopId last = tc.GetBusLastStop(bus);
 
             AddTextWithBackground(
                 doc,
                 proj,
-                bus->first->coords,
+                tc.GetStopCoordinates(first),
                 settings_.bus_label_offset,
-                bus->name,
+                tc.GetBusName(bus),
                 bus_color,
                 settings_.bus_label_font_size,
                 true
             );
-            if ((!bus->is_roundtrip) && (bus->first != bus->last)) {
+            if ((!tc.IsRoundtrip(bus)) && (first != last)) {
                 AddTextWithBackground(
                     doc,
                     proj,
-                    bus->last->coords,
+                    tc.GetStopCoordinates(last),
                     settings_.bus_label_offset,
-                    bus->name,
+                    tc.GetBusName(bus),
                     bus_color,
                     settings_.bus_label_font_size,
                     true
@@ -153,10 +155,10 @@ namespace map_renderer {
     void MapRenderer::AddTextWithBackground(
         svg::Document& doc,
         const SphereProjector& proj,
-        geo::Coordinates& coords,
+        geo::Coordinates coords,
         std::pair<double, double> offset,
-        std::string& data,
-        svg::Color& text_color,
+        std::string_view data,
+        const svg::Color& text_color,
         int font_size,
         bool is_bold
     ) const {
@@ -165,7 +167,7 @@ namespace map_renderer {
             .SetOffset(offset)
             .SetFontSize(font_size)
             .SetFontFamily("Verdana")
-            .SetData(data);
+            .SetData(std::string(data));
         if (is_bold) {
             text.SetFontWeight("bold");
         }
@@ -182,15 +184,14 @@ namespace map_renderer {
     }
 
     void MapRenderer::AddStops(
-        const std::map<std::string_view, transport_catalogue::Stop*>* stops,
+        const transport_catalogue::TransportCatalogue& tc,
         svg::Document& doc,
-        std::vector<std::string_view>& stop_names,
+        const std::vector<transport_catalogue::StopId>& stops,
         const SphereProjector& proj
     ) const {
-        for (auto stop_name : stop_names) {
-            transport_catalogue::Stop* stop = stops->at(stop_name);
+        for (transport_catalogue::StopId stop : stops) {
             svg::Circle cir;
-            cir.SetCenter(proj(stop->coords))
+            cir.SetCenter(proj(tc.GetStopCoordinates(stop)))
                .SetRadius(settings_.stop_radius)
                .SetFillColor("white");
             doc.Add(cir);
@@ -198,20 +199,19 @@ namespace map_renderer {
     }
 
     void MapRenderer::AddStopNames(
-        const std::map<std::string_view, transport_catalogue::Stop*>* stops,
+        const transport_catalogue::TransportCatalogue& tc,
         svg::Document& doc,
-        std::vector<std::string_view>& stop_names,
+        const std::vector<transport_catalogue::StopId>& stops,
         const SphereProjector& proj
     ) const {
-        for (auto stop_name : stop_names) {
-            transport_catalogue::Stop* stop = stops->at(stop_name);
+        for (transport_catalogue::StopId stop : stops) {
             svg::Color black {"black"};
             AddTextWithBackground(
                 doc,
                 proj,
-                stop->coords,
+                tc.GetStopCoordinates(stop),
                 settings_.stop_label_offset,
-                stop->name,
+                tc.GetStopName(stop),
                 black,
                 settings_.stop_label_font_size,
                 false
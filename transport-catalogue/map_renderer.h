@@ -9,6 +9,7 @@
 
 #include "svg.h"
 #include "domain.h"
+#include "transport_catalogue.h"
 
 namespace map_renderer {
 
@@ -115,50 +116,50 @@ namespace map_renderer {
         MapRenderer(const MapSettings& settings);
 
         void Render(
-            const std::map<std::string_view, transport_catalogue::Bus*>* buses,
-            const std::map<std::string_view, transport_catalogue::Stop*>* stops,
+            const transport_catalogue::TransportCatalogue& tc,
             std::ostream& ostream
         ) const;
 
     private:
         const MapSettings& settings_;
 
+        // Buses and stops come in the order of their names
         void AddLines(
-            const std::map<std::string_view, transport_catalogue::Bus*>* buses,
+            const transport_catalogue::TransportCatalogue& tc,
             svg::Document& doc,
-            std::vector<std::string_view>& bus_names,
+            const std::vector<transport_catalogue::BusId>& buses,
             const SphereProjector& proj
         ) const;
 
         void AddLineTexts(
-            const std::map<std::string_view, transport_catalogue::Bus*>* buses,
+            const transport_catalogue::TransportCatalogue& tc,
             svg::Document& doc,
-            std::vector<std::string_view>& bus_names,
+            const std::vector<transport_catalogue::BusId>& buses,
             const SphereProjector& proj
         ) const;
 
         void AddTextWithBackground(
             svg::Document& doc,
             const SphereProjector& proj,
-            geo::Coordinates& coords,
+            geo::Coordinates coords,
             std::pair<double, double> offset,
-            std::string& data,
-            svg::Color& text_color,
+            std::string_view data,
+            const svg::Color& text_color,
             int font_size,
             bool is_bold
         ) const;
 
         void AddStops(
-            const std::map<std::string_view, transport_catalogue::Stop*>* stops,
+            const transport_catalogue::TransportCatalogue& tc,
             svg::Document& doc,
-            std::vector<std::string_view>& stop_names,
+            const std::vector<transport_catalogue::StopId>& stops,
             const SphereProjector& proj
         ) const;
 
         void AddStopNames(
-            const std::map<std::string_view, transport_catalogue::Stop*>* stops,
+            const transport_catalogue::TransportCatalogue& tc,
             svg::Document& doc,
-            std::vector<std::string_view>& stop_names,
+            const std::vector<transport_catalogue::StopId>& stops,
             const SphereProjector& proj
         ) const;
 
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace mapped_file {
+
+    // Read-only memory mapping of a whole file. Pages are faulted in lazily on first access.
+    class MappedFile {
+    public:
+        explicit MappedFile(const std::string& path);
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        MappedFile(MappedFile&& other) noexcept;
+        MappedFile& operator=(MappedFile&& other) noexcept;
+
+        const char* Data() const;
+        size_t Size() const;
+
+    private:
+        void Unmap();
+
+        const char* data_ = nullptr;
+        size_t size_ = 0;
+    };
+
+}  // namespace mapped_file
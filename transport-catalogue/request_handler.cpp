@@ -1,11 +1,17 @@
 #include "request_handler.h"
 
+#include <algorithm>
 #include <sstream>
+#include <thread>
 
 #include <iostream>
 
 
 namespace request_handler {
+    namespace {
+        constexpr size_t MIN_SOURCES_PER_THREAD = 8;
+    }
+
     BusStat::BusStat(double curvature, double route_length, int stop_count, int unique_stop_count) :
         curvature(curvature),
         route_length(route_length),
@@ -17,7 +23,7 @@ namespace request_handler {
         const transport_catalogue::TransportCatalogue& db,
         const map_renderer::MapRenderer& renderer,
         const graph::DirectedWeightedGraph<double>& directed_graph,
-        const graph::Router<double>& router
+        const graph::RouterInterface<double>& router
     ) :
         db_(db),
         map_renderer_(renderer),
@@ -26,61 +32,123 @@ namespace request_handler {
     {}
 
     std::optional<BusStat> RequestHandler::GetBusStat(const std::string_view& bus_name) const {
-        auto busname_to_bus = db_.GetBusnames();
-        if (busname_to_bus.find(bus_name) == busname_to_bus.end()) {
+        const transport_catalogue::BusId bus = db_.FindBus(bus_name);
+        if (bus == transport_catalogue::NO_BUS) {
             return std::nullopt;
         }
-        transport_catalogue::Bus* bus = busname_to_bus.at(bus_name);
-        BusStat bus_stat {bus->GetCurvature(),
-                          bus->GetTrueDistance(),
-                          static_cast<int>(bus->stops.size()),
-                          static_cast<int>(bus->unique_stops.size())};
+        BusStat bus_stat {db_.GetBusRouteLength(bus) / db_.GetBusGeoLength(bus),
+                          db_.GetBusRouteLength(bus),
+                          static_cast<int>(db_.GetBusStopCount(bus)),
+                          static_cast<int>(db_.GetBusUniqueStopCount(bus))};
         return bus_stat;
     }
 
-    const std::unordered_set<transport_catalogue::Bus*>* RequestHandler::GetBusesByStop(const std::string_view& stop_name) const {
-        auto stopname_to_stop = db_.GetStopnames();
-        if (stopname_to_stop.find(stop_name) == stopname_to_stop.end()) {
-            return nullptr;
+    std::optional<transport_catalogue::TransportCatalogue::BusRange> RequestHandler::GetBusesByStop(const std::string_view& stop_name) const {
+        const transport_catalogue::StopId stop = db_.FindStop(stop_name);
+        if (stop == transport_catalogue::NO_STOP) {
+            return std::nullopt;
         }
-        transport_catalogue::Stop* stop = stopname_to_stop.at(stop_name);
         return db_.GetBusesByStop(stop);
     }
 
     std::string RequestHandler::RenderMap() const {
         std::ostringstream sstream;
-        map_renderer_.Render(
-            db_.GetBusnamesPtr(),
-            db_.GetStopnamesPtr(),
-            sstream
-        );
+        map_renderer_.Render(db_, sstream);
         return sstream.str();
     }
 
-    std::optional<graph::Router<double>::RouteInfo> RequestHandler::RouteInfo(const std::string_view from_stop_name, const std::string_view to_stop_name) const {
-        auto stopname_to_stop = db_.GetStopnames();
-        if (stopname_to_stop.find(from_stop_name) == stopname_to_stop.end()) {
-            return {};
-        }
-        if (stopname_to_stop.find(to_stop_name) == stopname_to_stop.end()) {
+    std::optional<graph::RouteInfo<double>> RequestHandler::RouteInfo(const std::string_view from_stop_name, const std::string_view to_stop_name) const {
+        const transport_catalogue::StopId from_stop = db_.FindStop(from_stop_name);
+        const transport_catalogue::StopId to_stop = db_.FindStop(to_stop_name);
+        if (from_stop == transport_catalogue::NO_STOP || to_stop == transport_catalogue::NO_STOP) {
             return {};
         }
-        transport_catalogue::Stop* from_stop = stopname_to_stop.at(from_stop_name);
-        transport_catalogue::Stop* to_stop = stopname_to_stop.at(to_stop_name);
-        size_t start_vortex = from_stop->in_vertex;
-        size_t end_vortex = to_stop->in_vertex;
+        size_t start_vortex = transport_catalogue::TransportCatalogue::GetInVertex(from_stop);
+        size_t end_vortex = transport_catalogue::TransportCatalogue::GetInVertex(to_stop);
         return router_.BuildRoute(start_vortex, end_vortex);
     }
 
+    std::vector<RouteItem> RequestHandler::RouteItems(const graph::RouteInfo<double>& route_info) const {
+        std::vector<RouteItem> items;
+        for (auto edge_id : route_info.edges) {
+            const auto& edge = directed_graph_.GetEdge(edge_id);
+            auto [bus, span] = db_.GetEdgeSpanToBus(edge_id);
+            if (bus == transport_catalogue::NO_BUS) {
+                items.push_back({edge.weight, StopByVertex(edge.from), transport_catalogue::NO_BUS, 0});
+                continue;
+            }
+            if (!items.empty() && items.back().bus == bus) {
+                items.back().time += edge.weight;
+                items.back().span_count += span;
+            } else {
+                items.push_back({edge.weight, transport_catalogue::NO_STOP, bus, span});
+            }
+        }
+        return items;
+    }
+
+    std::optional<std::vector<std::vector<std::optional<double>>>> RequestHandler::TravelTimeMatrix(
+        const std::vector<std::string_view>& from_stop_names,
+        const std::vector<std::string_view>& to_stop_names
+    ) const {
+        auto to_vertices = [this](const std::vector<std::string_view>& names) {
+            std::optional<std::vector<graph::VertexId>> vertices(std::in_place);
+            for (auto name : names) {
+                const transport_catalogue::StopId stop = db_.FindStop(name);
+                if (stop == transport_catalogue::NO_STOP) {
+                    return std::optional<std::vector<graph::VertexId>>{};
+                }
+                vertices->push_back(transport_catalogue::TransportCatalogue::GetInVertex(stop));
+            }
+            return vertices;
+        };
+        auto sources = to_vertices(from_stop_names);
+        auto targets = to_vertices(to_stop_names);
+        if (!sources || !targets) {
+            return std::nullopt;
+        }
+
+        std::vector<std::vector<std::optional<double>>> matrix(sources->size());
+        // A thread is started only for a batch of searches, small matrices are computed inline
+        const size_t thread_count = std::min<size_t>(
+            std::max(1u, std::thread::hardware_concurrency()),
+            (sources->size() + MIN_SOURCES_PER_THREAD - 1) / MIN_SOURCES_PER_THREAD
+        );
+        auto worker = [this, &sources, &targets, &matrix, thread_count](size_t thread_index) {
+            for (size_t i = thread_index; i < sources->size(); i += thread_count) {
+                matrix[i] = router_.ComputeRouteWeights((*sources)[i], *targets);
+            }
+        };
+        std::vector<std::thread> threads;
+        for (size_t thread_index = 1; thread_index < thread_count; ++thread_index) {
+            threads.emplace_back(worker, thread_index);
+        }
+        if (thread_count > 0) {
+            worker(0);
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        return matrix;
+    }
+
     graph::Edge<double> RequestHandler::GraphEdgeInfo(graph::EdgeId edge_id) const {
         return directed_graph_.GetEdge(edge_id);
     }
 
-    transport_catalogue::Stop* RequestHandler::StopByVertex(size_t vertex_id) const {
-        return db_.GetVertexToStops()->at(vertex_id);
+    transport_catalogue::StopId RequestHandler::StopByVertex(size_t vertex_id) const {
+        return db_.StopByVertex(vertex_id);
+    }
+
+    std::pair<transport_catalogue::BusId, int> RequestHandler::BusSpanByEdge(size_t edge_id) const {
+        return db_.GetEdgeSpanToBus(edge_id);
+    }
+
+    std::string_view RequestHandler::GetStopName(transport_catalogue::StopId stop) const {
+        return db_.GetStopName(stop);
     }
 
-    std::pair<transport_catalogue::Bus*, int> RequestHandler::BusSpanByEdge(size_t edge_id) const {
-        return db_.GetEdgeSpanToBuses()->at(edge_id);
+    std::string_view RequestHandler::GetBusName(transport_catalogue::BusId bus) const {
+        return db_.GetBusName(bus);
     }
 }
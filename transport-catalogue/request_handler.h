@@ -5,7 +5,9 @@
 
 #include <optional>
 #include <string>
-#include <unordered_set>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 #include "graph.h"
 #include "map_renderer.h"
@@ -23,32 +25,50 @@ namespace request_handler {
         int unique_stop_count;
     };
 
+    // Item of a route answer: waiting at the stop if bus is NO_BUS, riding the bus otherwise
+    struct RouteItem {
+        double time;
+        transport_catalogue::StopId stop;
+        transport_catalogue::BusId bus;
+        int span_count;
+    };
+
     class RequestHandler {
     public:
         RequestHandler(
             const transport_catalogue::TransportCatalogue& db,
             const map_renderer::MapRenderer& renderer,
             const graph::DirectedWeightedGraph<double>& directed_graph,
-            const graph::Router<double>& router
+            const graph::RouterInterface<double>& router
         );
 
         // Возвращает информацию о маршруте (запрос Bus)
         std::optional<BusStat> GetBusStat(const std::string_view& bus_name) const;
 
-        // Возвращает маршруты, проходящие через остановку
-        const std::unordered_set<transport_catalogue::Bus*>* GetBusesByStop(const std::string_view& stop_name) const;
+        // Возвращает маршруты, проходящие через остановку, в порядке их названий
+        std::optional<transport_catalogue::TransportCatalogue::BusRange> GetBusesByStop(const std::string_view& stop_name) const;
 
         std::string RenderMap() const;
 
-        std::optional<graph::Router<double>::RouteInfo> RouteInfo(const std::string_view from_stop_name, const std::string_view to_stop_name) const;
+        std::optional<graph::RouteInfo<double>> RouteInfo(const std::string_view from_stop_name, const std::string_view to_stop_name) const;
+        // Converts route edges into Wait/Bus items, merging consecutive edges of one bus trip
+        std::vector<RouteItem> RouteItems(const graph::RouteInfo<double>& route_info) const;
+        // Travel times between all pairs of stops, one search per origin and origins in parallel.
+        // Returns std::nullopt if any stop is unknown, unreachable pairs are std::nullopt.
+        std::optional<std::vector<std::vector<std::optional<double>>>> TravelTimeMatrix(
+            const std::vector<std::string_view>& from_stop_names,
+            const std::vector<std::string_view>& to_stop_names
+        ) const;
         graph::Edge<double> GraphEdgeInfo(graph::EdgeId edge_id) const;
-        transport_catalogue::Stop* StopByVertex(size_t vertex_id) const;
-        std::pair<transport_catalogue::Bus*, int> BusSpanByEdge(size_t edge_id) const;
+        transport_catalogue::StopId StopByVertex(size_t vertex_id) const;
+        std::pair<transport_catalogue::BusId, int> BusSpanByEdge(size_t edge_id) const;
+        std::string_view GetStopName(transport_catalogue::StopId stop) const;
+        std::string_view GetBusName(transport_catalogue::BusId bus) const;
 
     private:
         const transport_catalogue::TransportCatalogue& db_;
         const map_renderer::MapRenderer& map_renderer_;
         const graph::DirectedWeightedGraph<double>& directed_graph_;
-        const graph::Router<double>& router_;
+        const graph::RouterInterface<double>& router_;
     };
 }
@@ -3,11 +3,15 @@
 #include "graph.h"
 
 #include <algorithm>
+#include <barrier>
 #include <cassert>
 #include <cstdint>
 #include <iterator>
+#include <limits>
 #include <optional>
+#include <ostream>
 #include <stdexcept>
+#include <thread>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -15,99 +19,251 @@
 namespace graph {
 
     template <typename Weight>
-    class Router {
+    struct RouteInfo {
+        Weight weight;
+        std::vector<EdgeId> edges;
+    };
+
+    // Common interface of all routing engines, so the request handler doesn't care
+    // whether routes are precomputed or searched on demand.
+    template <typename Weight>
+    class RouterInterface {
+    public:
+        virtual ~RouterInterface() = default;
+
+        virtual std::optional<RouteInfo<Weight>> BuildRoute(VertexId from, VertexId to) const = 0;
+
+        // Weights of routes from one vertex to many, std::nullopt for unreachable targets.
+        // Engines override it when they can serve all targets with one search.
+        virtual std::vector<std::optional<Weight>> ComputeRouteWeights(VertexId from,
+                                                                       const std::vector<VertexId>& targets) const {
+            std::vector<std::optional<Weight>> weights;
+            weights.reserve(targets.size());
+            for (const VertexId to : targets) {
+                if (auto route = BuildRoute(from, to)) {
+                    weights.push_back(route->weight);
+                } else {
+                    weights.push_back(std::nullopt);
+                }
+            }
+            return weights;
+        }
+
+        // Engines which count what they do print it, the others print nothing
+        virtual void PrintStats(std::ostream& output) const {
+            (void)output;
+        }
+    };
+
+    // Precomputes routes between all pairs of vertices with Floyd-Warshall, so every query is a table walk.
+    // The tables are split into square tiles which are relaxed phase by phase
+    // (diagonal tile, its row and column, then the remaining tiles), and tiles of one phase
+    // are independent, so they are shared between worker threads.
+    template <typename Weight>
+    class Router : public RouterInterface<Weight> {
     private:
         using Graph = DirectedWeightedGraph<Weight>;
 
     public:
-        explicit Router(const Graph& graph);
+        explicit Router(const Graph& graph, size_t thread_count = std::thread::hardware_concurrency());
+        // Uses tables computed earlier, e.g. mapped from a file. They have to outlive the router.
+        Router(const Graph& graph, const Weight* weights_table, const EdgeId* prev_edges_table);
 
-        struct RouteInfo {
-            Weight weight;
-            std::vector<EdgeId> edges;
-        };
+        Router(const Router&) = delete;
+        Router& operator=(const Router&) = delete;
+        Router(Router&&) = default;
 
-        std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+        using RouteInfo = graph::RouteInfo<Weight>;
+
+        std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+
+        std::vector<std::optional<Weight>> ComputeRouteWeights(VertexId from,
+                                                               const std::vector<VertexId>& targets) const override;
+
+        // Row-major vertex_count x vertex_count tables: the route weight (infinite if unreachable)
+        // and the id of the last edge of the route (-1 for empty routes)
+        const Weight* GetWeightsTable() const;
+        const EdgeId* GetPrevEdgesTable() const;
 
     private:
-        struct RouteInternalData {
-            Weight weight;
-            std::optional<EdgeId> prev_edge;
-        };
-        using RoutesInternalData = std::vector<std::vector<std::optional<RouteInternalData>>>;
+        static_assert(std::numeric_limits<Weight>::has_infinity, "Unreachable routes are stored as infinite weights");
+
+        static constexpr Weight ZERO_WEIGHT{};
+        static constexpr Weight UNREACHABLE = std::numeric_limits<Weight>::infinity();
+        static constexpr EdgeId NO_EDGE = static_cast<EdgeId>(-1);
+        static constexpr size_t TILE_SIZE = 64;
 
         void InitializeRoutesInternalData(const Graph& graph) {
             const size_t vertex_count = graph.GetVertexCount();
+            const auto compact_graph = graph.GetCompactGraph();
             for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
-                routes_internal_data_[vertex][vertex] = RouteInternalData{ZERO_WEIGHT, std::nullopt};
-                for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
-                    const auto& edge = graph.GetEdge(edge_id);
-                    if (edge.weight < ZERO_WEIGHT) {
+                weights_[vertex * vertex_count + vertex] = ZERO_WEIGHT;
+                for (size_t arc = compact_graph->ArcsBegin(vertex); arc < compact_graph->ArcsEnd(vertex); ++arc) {
+                    const Weight weight = compact_graph->GetWeight(arc);
+                    if (weight < ZERO_WEIGHT) {
                         throw std::domain_error("Edges' weights should be non-negative");
                     }
-                    auto& route_internal_data = routes_internal_data_[vertex][edge.to];
-                    if (!route_internal_data || route_internal_data->weight > edge.weight) {
-                        route_internal_data = RouteInternalData{edge.weight, edge_id};
+                    const size_t index = vertex * vertex_count + compact_graph->GetTarget(arc);
+                    if (weight < weights_[index]) {
+                        weights_[index] = weight;
+                        prev_edges_[index] = compact_graph->GetEdgeId(arc);
                     }
                 }
             }
         }
 
-        void RelaxRoute(VertexId vertex_from, VertexId vertex_to, const RouteInternalData& route_from,
-                        const RouteInternalData& route_to) {
-            auto& route_relaxing = routes_internal_data_[vertex_from][vertex_to];
-            const Weight candidate_weight = route_from.weight + route_to.weight;
-            if (!route_relaxing || candidate_weight < route_relaxing->weight) {
-                route_relaxing = {candidate_weight,
-                                  route_to.prev_edge ? route_to.prev_edge : route_from.prev_edge};
-            }
-        }
-
-        void RelaxRoutesInternalDataThroughVertex(size_t vertex_count, VertexId vertex_through) {
-            for (VertexId vertex_from = 0; vertex_from < vertex_count; ++vertex_from) {
-                if (const auto& route_from = routes_internal_data_[vertex_from][vertex_through]) {
-                    for (VertexId vertex_to = 0; vertex_to < vertex_count; ++vertex_to) {
-                        if (const auto& route_to = routes_internal_data_[vertex_through][vertex_to]) {
-                            RelaxRoute(vertex_from, vertex_to, *route_from, *route_to);
-                        }
+        // Relaxes routes of the tile (rows_tile, columns_tile) through the vertices of through_tile.
+        // The loop over intermediate vertices is the outer one, so the tile may overlap the other two.
+        void RelaxTile(size_t rows_tile, size_t columns_tile, size_t through_tile) {
+            const size_t vertex_count = vertex_count_;
+            const size_t row_end = std::min(vertex_count, (rows_tile + 1) * TILE_SIZE);
+            const size_t column_begin = columns_tile * TILE_SIZE;
+            const size_t column_end = std::min(vertex_count, column_begin + TILE_SIZE);
+            const size_t through_end = std::min(vertex_count, (through_tile + 1) * TILE_SIZE);
+            for (size_t vertex_through = through_tile * TILE_SIZE; vertex_through < through_end; ++vertex_through) {
+                const Weight* through_weights = &weights_[vertex_through * vertex_count];
+                const EdgeId* through_prev_edges = &prev_edges_[vertex_through * vertex_count];
+                for (size_t vertex_from = rows_tile * TILE_SIZE; vertex_from < row_end; ++vertex_from) {
+                    Weight* from_weights = &weights_[vertex_from * vertex_count];
+                    EdgeId* from_prev_edges = &prev_edges_[vertex_from * vertex_count];
+                    const Weight weight_to_through = from_weights[vertex_through];
+                    if (weight_to_through == UNREACHABLE) {
+                        continue;
+                    }
+                    // Branch-free min-plus kernel over contiguous rows, so the compiler can vectorise it.
+                    // A route through the vertex ends with the last edge of its route from the vertex.
+                    for (size_t vertex_to = column_begin; vertex_to < column_end; ++vertex_to) {
+                        const Weight candidate_weight = weight_to_through + through_weights[vertex_to];
+                        const bool is_better = candidate_weight < from_weights[vertex_to];
+                        from_weights[vertex_to] = is_better ? candidate_weight : from_weights[vertex_to];
+                        from_prev_edges[vertex_to] = is_better ? through_prev_edges[vertex_to] : from_prev_edges[vertex_to];
                     }
                 }
             }
         }
 
-        static constexpr Weight ZERO_WEIGHT{};
+        void RelaxAllTiles(size_t thread_count);
+
         const Graph& graph_;
-        RoutesInternalData routes_internal_data_;
+        size_t vertex_count_;
+        // Tables being computed, empty if the router uses external ones
+        std::vector<Weight> weights_;
+        std::vector<EdgeId> prev_edges_;
+        const Weight* weights_table_ = nullptr;
+        const EdgeId* prev_edges_table_ = nullptr;
     };
 
     template <typename Weight>
-    Router<Weight>::Router(const Graph& graph)
+    Router<Weight>::Router(const Graph& graph, size_t thread_count)
         : graph_(graph)
-        , routes_internal_data_(graph.GetVertexCount(),
-                                std::vector<std::optional<RouteInternalData>>(graph.GetVertexCount()))
+        , vertex_count_(graph.GetVertexCount())
+        , weights_(vertex_count_ * vertex_count_, UNREACHABLE)
+        , prev_edges_(vertex_count_ * vertex_count_, NO_EDGE)
     {
         InitializeRoutesInternalData(graph);
+        RelaxAllTiles(std::max<size_t>(thread_count, 1));
+        weights_table_ = weights_.data();
+        prev_edges_table_ = prev_edges_.data();
+    }
+
+    template <typename Weight>
+    Router<Weight>::Router(const Graph& graph, const Weight* weights_table, const EdgeId* prev_edges_table)
+        : graph_(graph)
+        , vertex_count_(graph.GetVertexCount())
+        , weights_table_(weights_table)
+        , prev_edges_table_(prev_edges_table)
+    {
+    }
 
-        const size_t vertex_count = graph.GetVertexCount();
-        for (VertexId vertex_through = 0; vertex_through < vertex_count; ++vertex_through) {
-            RelaxRoutesInternalDataThroughVertex(vertex_count, vertex_through);
+    template <typename Weight>
+    std::vector<std::optional<Weight>> Router<Weight>::ComputeRouteWeights(VertexId from,
+                                                                           const std::vector<VertexId>& targets) const {
+        std::vector<std::optional<Weight>> weights;
+        weights.reserve(targets.size());
+        for (const VertexId to : targets) {
+            if (from >= vertex_count_ || to >= vertex_count_) {
+                throw std::out_of_range("Vertex is out of graph");
+            }
+            const Weight weight = weights_table_[from * vertex_count_ + to];
+            weights.push_back(weight == UNREACHABLE ? std::nullopt : std::optional<Weight>(weight));
+        }
+        return weights;
+    }
+
+    template <typename Weight>
+    const Weight* Router<Weight>::GetWeightsTable() const {
+        return weights_table_;
+    }
+
+    template <typename Weight>
+    const EdgeId* Router<Weight>::GetPrevEdgesTable() const {
+        return prev_edges_table_;
+    }
+
+    template <typename Weight>
+    void Router<Weight>::RelaxAllTiles(size_t thread_count) {
+        const size_t tile_count = (vertex_count_ + TILE_SIZE - 1) / TILE_SIZE;
+        thread_count = std::min(thread_count, std::max<size_t>(tile_count, 1));
+        std::barrier phase_barrier(static_cast<std::ptrdiff_t>(thread_count));
+
+        const auto worker = [this, tile_count, thread_count, &phase_barrier](size_t thread_index) {
+            for (size_t through_tile = 0; through_tile < tile_count; ++through_tile) {
+                if (thread_index == 0) {
+                    RelaxTile(through_tile, through_tile, through_tile);
+                }
+                phase_barrier.arrive_and_wait();
+
+                // Tiles of the row and the column of the diagonal tile only depend on the diagonal one
+                for (size_t tile = thread_index; tile < tile_count; tile += thread_count) {
+                    if (tile != through_tile) {
+                        RelaxTile(through_tile, tile, through_tile);
+                        RelaxTile(tile, through_tile, through_tile);
+                    }
+                }
+                phase_barrier.arrive_and_wait();
+
+                // Every remaining tile depends only on its row and column tiles, rows are split between threads
+                for (size_t rows_tile = thread_index; rows_tile < tile_count; rows_tile += thread_count) {
+                    if (rows_tile == through_tile) {
+                        continue;
+                    }
+                    for (size_t columns_tile = 0; columns_tile < tile_count; ++columns_tile) {
+                        if (columns_tile != through_tile) {
+                            RelaxTile(rows_tile, columns_tile, through_tile);
+                        }
+                    }
+                }
+                phase_barrier.arrive_and_wait();
+            }
+        };
+
+        std::vector<std::thread> threads;
+        threads.reserve(thread_count - 1);
+        for (size_t thread_index = 1; thread_index < thread_count; ++thread_index) {
+            threads.emplace_back(worker, thread_index);
+        }
+        worker(0);
+        for (auto& thread : threads) {
+            thread.join();
         }
     }
 
     template <typename Weight>
     std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(VertexId from,
                                                                                  VertexId to) const {
-        const auto& route_internal_data = routes_internal_data_.at(from).at(to);
-        if (!route_internal_data) {
+        if (from >= vertex_count_ || to >= vertex_count_) {
+            throw std::out_of_range("Vertex is out of graph");
+        }
+        const Weight weight = weights_table_[from * vertex_count_ + to];
+        if (weight == UNREACHABLE) {
             return std::nullopt;
         }
-        const Weight weight = route_internal_data->weight;
         std::vector<EdgeId> edges;
-        for (std::optional<EdgeId> edge_id = route_internal_data->prev_edge;
-             edge_id;
-             edge_id = routes_internal_data_[from][graph_.GetEdge(*edge_id).from]->prev_edge)
+        for (EdgeId edge_id = prev_edges_table_[from * vertex_count_ + to];
+             edge_id != NO_EDGE;
+             edge_id = prev_edges_table_[from * vertex_count_ + graph_.GetEdge(edge_id).from])
         {
-            edges.push_back(*edge_id);
+            edges.push_back(edge_id);
         }
         std::reverse(edges.begin(), edges.end());
 
@@ -0,0 +1,183 @@
+#include "router_storage.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+namespace router_storage {
+    namespace {
+        const char MAGIC[8] = {'T', 'C', 'R', 'O', 'U', 'T', 'E', 'S'};
+        const uint64_t NO_STOP = std::numeric_limits<uint64_t>::max();
+
+        // All sections consist of 8-byte values, so every table in the mapping stays aligned
+        struct Header {
+            char magic[8];
+            uint32_t version;
+            uint32_t weight_size;
+            uint64_t checksum;
+            uint64_t vertex_count;
+            uint64_t edge_count;
+        };
+
+        struct StoredEdge {
+            uint64_t from;
+            uint64_t to;
+            double weight;
+        };
+
+        class Hasher {
+        public:
+            void Add(const void* data, size_t size) {
+                const auto* bytes = static_cast<const unsigned char*>(data);
+                for (size_t i = 0; i < size; ++i) {
+                    hash_ = (hash_ ^ bytes[i]) * 1099511628211ull;
+                }
+            }
+
+            template <typename T>
+            void Add(const T& value) {
+                Add(&value, sizeof(value));
+            }
+
+            uint64_t Get() const {
+                return hash_;
+            }
+
+        private:
+            // FNV-1a
+            uint64_t hash_ = 14695981039346656037ull;
+        };
+
+        // Index of the vertex's stop in the name order, or NO_STOP for vertices without a stop
+        std::vector<uint64_t> VertexToStop(size_t vertex_count, const transport_catalogue::TransportCatalogue& tc) {
+            std::vector<uint64_t> vertex_to_stop(vertex_count, NO_STOP);
+            uint64_t stop_index = 0;
+            for (const auto& [name, stop] : *tc.GetStopnamesPtr()) {
+                for (size_t vertex : {transport_catalogue::TransportCatalogue::GetInVertex(stop),
+                                      transport_catalogue::TransportCatalogue::GetOutVertex(stop)}) {
+                    if (vertex < vertex_count) {
+                        vertex_to_stop[vertex] = stop_index;
+                    }
+                }
+                ++stop_index;
+            }
+            return vertex_to_stop;
+        }
+
+        size_t ExpectedFileSize(const Header& header) {
+            return sizeof(Header)
+                + header.edge_count * sizeof(StoredEdge)
+                + header.vertex_count * sizeof(uint64_t)
+                + header.vertex_count * header.vertex_count * (sizeof(double) + sizeof(graph::EdgeId));
+        }
+    }
+
+    uint64_t ComputeChecksum(const graph::DirectedWeightedGraph<double>& directed_graph,
+                             const transport_catalogue::TransportCatalogue& tc) {
+        Hasher hasher;
+        hasher.Add(FORMAT_VERSION);
+        hasher.Add(static_cast<uint64_t>(directed_graph.GetVertexCount()));
+        hasher.Add(static_cast<uint64_t>(directed_graph.GetEdgeCount()));
+        for (graph::EdgeId edge_id = 0; edge_id < directed_graph.GetEdgeCount(); ++edge_id) {
+            const auto& edge = directed_graph.GetEdge(edge_id);
+            hasher.Add(StoredEdge{edge.from, edge.to, edge.weight});
+        }
+        for (const auto& [name, stop] : *tc.GetStopnamesPtr()) {
+            hasher.Add(name.data(), name.size());
+            hasher.Add(static_cast<uint64_t>(transport_catalogue::TransportCatalogue::GetInVertex(stop)));
+        }
+        return hasher.Get();
+    }
+
+    bool SaveRouter(const std::string& path,
+                    uint64_t checksum,
+                    const graph::DirectedWeightedGraph<double>& directed_graph,
+                    const transport_catalogue::TransportCatalogue& tc,
+                    const graph::Router<double>& router) {
+        Header header;
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = FORMAT_VERSION;
+        header.weight_size = sizeof(double);
+        header.checksum = checksum;
+        header.vertex_count = directed_graph.GetVertexCount();
+        header.edge_count = directed_graph.GetEdgeCount();
+
+        // Write to a temporary file first, so a reader never maps a half-written one
+        const std::string tmp_path = path + ".tmp";
+        {
+            std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            for (graph::EdgeId edge_id = 0; edge_id < directed_graph.GetEdgeCount(); ++edge_id) {
+                const auto& edge = directed_graph.GetEdge(edge_id);
+                const StoredEdge stored_edge{edge.from, edge.to, edge.weight};
+                out.write(reinterpret_cast<const char*>(&stored_edge), sizeof(stored_edge));
+            }
+            const auto vertex_to_stop = VertexToStop(header.vertex_count, tc);
+            out.write(reinterpret_cast<const char*>(vertex_to_stop.data()), vertex_to_stop.size() * sizeof(uint64_t));
+            const size_t table_size = header.vertex_count * header.vertex_count;
+            out.write(reinterpret_cast<const char*>(router.GetWeightsTable()), table_size * sizeof(double));
+            out.write(reinterpret_cast<const char*>(router.GetPrevEdgesTable()), table_size * sizeof(graph::EdgeId));
+            if (!out) {
+                std::error_code error;
+                std::filesystem::remove(tmp_path, error);
+                return false;
+            }
+        }
+        std::error_code error;
+        std::filesystem::rename(tmp_path, path, error);
+        if (error) {
+            std::filesystem::remove(tmp_path, error);
+            return false;
+        }
+        return true;
+    }
+
+    MappedRouter::MappedRouter(mapped_file::MappedFile file,
+                               const graph::DirectedWeightedGraph<double>& directed_graph,
+                               const double* weights_table,
+                               const graph::EdgeId* prev_edges_table) :
+        file_(std::move(file)),
+        router_(directed_graph, weights_table, prev_edges_table)
+    {}
+
+    std::optional<graph::RouteInfo<double>> MappedRouter::BuildRoute(graph::VertexId from, graph::VertexId to) const {
+        return router_.BuildRoute(from, to);
+    }
+
+    std::unique_ptr<MappedRouter> LoadRouter(const std::string& path,
+                                             uint64_t checksum,
+                                             const graph::DirectedWeightedGraph<double>& directed_graph) {
+        static_assert(sizeof(graph::EdgeId) == sizeof(uint64_t), "Edge ids are stored as 64-bit values");
+        if (!std::filesystem::exists(path)) {
+            return nullptr;
+        }
+        mapped_file::MappedFile file(path);
+        if (file.Size() < sizeof(Header)) {
+            return nullptr;
+        }
+        Header header;
+        std::memcpy(&header, file.Data(), sizeof(header));
+        if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0
+            || header.version != FORMAT_VERSION
+            || header.weight_size != sizeof(double)
+            || header.checksum != checksum
+            || header.vertex_count != directed_graph.GetVertexCount()
+            || header.edge_count != directed_graph.GetEdgeCount()
+            || file.Size() != ExpectedFileSize(header)) {
+            return nullptr;
+        }
+
+        const char* tables = file.Data()
+            + sizeof(Header)
+            + header.edge_count * sizeof(StoredEdge)
+            + header.vertex_count * sizeof(uint64_t);
+        const auto* weights_table = reinterpret_cast<const double*>(tables);
+        const auto* prev_edges_table = reinterpret_cast<const graph::EdgeId*>(
+            tables + header.vertex_count * header.vertex_count * sizeof(double));
+        return std::make_unique<MappedRouter>(std::move(file), directed_graph, weights_table, prev_edges_table);
+    }
+}
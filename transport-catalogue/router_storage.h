@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "graph.h"
+#include "mapped_file.h"
+#include "router.h"
+#include "transport_catalogue.h"
+
+// Persists precomputed all-pairs router tables, so a restart with unchanged base data
+// maps them from a file instead of running Floyd-Warshall again.
+namespace router_storage {
+    // Layout version of the file, bump it on every format change
+    inline const uint32_t FORMAT_VERSION = 1;
+
+    // Fingerprint of the base data the routes depend on: the graph and the stops of its vertices
+    uint64_t ComputeChecksum(const graph::DirectedWeightedGraph<double>& directed_graph,
+                             const transport_catalogue::TransportCatalogue& tc);
+
+    // Writes the graph, vertex to stop mapping and the router tables.
+    // Returns false if the file can't be written, no part of it is left behind then
+    bool SaveRouter(const std::string& path,
+                    uint64_t checksum,
+                    const graph::DirectedWeightedGraph<double>& directed_graph,
+                    const transport_catalogue::TransportCatalogue& tc,
+                    const graph::Router<double>& router);
+
+    // Router answering from the tables of a mapped file
+    class MappedRouter : public graph::RouterInterface<double> {
+    public:
+        MappedRouter(mapped_file::MappedFile file,
+                     const graph::DirectedWeightedGraph<double>& directed_graph,
+                     const double* weights_table,
+                     const graph::EdgeId* prev_edges_table);
+
+        std::optional<graph::RouteInfo<double>> BuildRoute(graph::VertexId from, graph::VertexId to) const override;
+
+    private:
+        mapped_file::MappedFile file_;
+        graph::Router<double> router_;
+    };
+
+    // Returns nullptr if there is no valid file, or it was written for other base data
+    std::unique_ptr<MappedRouter> LoadRouter(const std::string& path,
+                                             uint64_t checksum,
+                                             const graph::DirectedWeightedGraph<double>& directed_graph);
+}
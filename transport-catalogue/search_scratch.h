@@ -0,0 +1,63 @@
+#pragma once
+
+#include "graph.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace graph {
+
+    // Buffers of one search direction over the vertices of a graph
+    template <typename Weight, typename QueueItem>
+    struct SearchSide {
+        std::vector<Weight> weights;
+        // The edge (or arc) by which the vertex has been reached and the vertex it leads from
+        std::vector<EdgeId> prev_edges;
+        std::vector<VertexId> prev_vertices;
+        std::vector<uint32_t> stamps;
+        std::vector<QueueItem> heap;
+    };
+
+    // Per-thread buffers reused between queries, one side per search direction. Vertices are reset lazily:
+    // a vertex's data in a side is valid only if its stamp there equals the current query stamp.
+    template <typename Weight, typename QueueItem, size_t SideCount = 1>
+    struct SearchScratch {
+        using Side = SearchSide<Weight, QueueItem>;
+
+        std::array<Side, SideCount> sides;
+        uint32_t stamp = 0;
+
+        // Starts a new query over a graph of vertex_count vertices
+        void Prepare(size_t vertex_count) {
+            for (Side& side : sides) {
+                if (side.stamps.size() < vertex_count) {
+                    side.weights.resize(vertex_count);
+                    side.prev_edges.resize(vertex_count);
+                    side.prev_vertices.resize(vertex_count);
+                    side.stamps.resize(vertex_count, 0);
+                }
+                side.heap.clear();
+            }
+            if (++stamp == 0) {
+                for (Side& side : sides) {
+                    std::fill(side.stamps.begin(), side.stamps.end(), 0);
+                }
+                stamp = 1;
+            }
+        }
+
+        bool IsReached(const Side& side, VertexId vertex) const {
+            return side.stamps[vertex] == stamp;
+        }
+    };
+
+    // The scratch of the calling thread, shared by all searches with the same type of scratch
+    template <typename Scratch>
+    Scratch& GetThreadScratch() {
+        static thread_local Scratch scratch;
+        return scratch;
+    }
+
+}  // namespace graph
@@ -0,0 +1,227 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+    // Computes the full shortest-path tree of a source vertex on its first query and keeps
+    // the recently used trees in an LRU cache limited by a memory budget.
+    // A query from a cached source only walks the predecessor array of its tree.
+    // Thread-safe: trees are shared with the queries which use them, so eviction never
+    // invalidates a tree in use.
+    template <typename Weight>
+    class SptCacheRouter : public RouterInterface<Weight> {
+    private:
+        using Graph = DirectedWeightedGraph<Weight>;
+
+    public:
+        struct CacheStats {
+            size_t hits = 0;
+            size_t misses = 0;
+            size_t evictions = 0;
+            size_t cached_trees = 0;
+            // Number of trees which fit into the memory budget, at least one
+            size_t capacity = 0;
+        };
+
+        SptCacheRouter(const Graph& graph, size_t memory_budget);
+
+        using RouteInfo = graph::RouteInfo<Weight>;
+
+        std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+
+        std::vector<std::optional<Weight>> ComputeRouteWeights(VertexId from,
+                                                               const std::vector<VertexId>& targets) const override;
+
+        CacheStats GetCacheStats() const;
+
+        // One line of the cache stats
+        void PrintStats(std::ostream& output) const override;
+
+    private:
+        using Index = typename CompactGraph<Weight>::Index;
+
+        static constexpr Weight ZERO_WEIGHT{};
+        static constexpr Weight UNREACHABLE = std::numeric_limits<Weight>::infinity();
+        static constexpr Index NO_EDGE = std::numeric_limits<Index>::max();
+
+        struct Tree {
+            std::vector<Weight> weights;
+            std::vector<Index> prev_edges;
+
+            static size_t GetMemorySize(size_t vertex_count) {
+                return vertex_count * (sizeof(Weight) + sizeof(Index));
+            }
+        };
+
+        struct CacheEntry {
+            std::shared_ptr<const Tree> tree;
+            typename std::list<VertexId>::iterator lru_position;
+        };
+
+        std::shared_ptr<const Tree> GetTree(VertexId from) const;
+        std::shared_ptr<const Tree> ComputeTree(VertexId from) const;
+
+        std::shared_ptr<const CompactGraph<Weight>> graph_;
+        // Source vertex of every edge, to walk trees back by predecessor edges
+        std::vector<Index> edge_sources_;
+        size_t capacity_;
+
+        mutable std::mutex mutex_;
+        // Most recently used sources first
+        mutable std::list<VertexId> lru_;
+        mutable std::unordered_map<VertexId, CacheEntry> cache_;
+        mutable CacheStats stats_;
+    };
+
+    template <typename Weight>
+    SptCacheRouter<Weight>::SptCacheRouter(const Graph& graph, size_t memory_budget)
+        : graph_(graph.GetCompactGraph())
+        , capacity_(std::max<size_t>(1, memory_budget / std::max<size_t>(1, Tree::GetMemorySize(graph.GetVertexCount()))))
+    {
+        edge_sources_.reserve(graph.GetEdgeCount());
+        for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+            const auto& edge = graph.GetEdge(edge_id);
+            if (edge.weight < ZERO_WEIGHT) {
+                throw std::domain_error("Edges' weights should be non-negative");
+            }
+            edge_sources_.push_back(static_cast<Index>(edge.from));
+        }
+        stats_.capacity = capacity_;
+    }
+
+    template <typename Weight>
+    std::shared_ptr<const typename SptCacheRouter<Weight>::Tree> SptCacheRouter<Weight>::ComputeTree(VertexId from) const {
+        auto tree = std::make_shared<Tree>();
+        tree->weights.assign(graph_->GetVertexCount(), UNREACHABLE);
+        tree->prev_edges.assign(graph_->GetVertexCount(), NO_EDGE);
+
+        using QueueItem = std::pair<Weight, VertexId>;
+        std::vector<QueueItem> heap;
+        const auto cmp = std::greater<QueueItem>{};
+        tree->weights[from] = ZERO_WEIGHT;
+        heap.push_back({ZERO_WEIGHT, from});
+        while (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), cmp);
+            const auto [weight, vertex] = heap.back();
+            heap.pop_back();
+            if (weight > tree->weights[vertex]) {
+                // Stale entry, the vertex has already been settled with a smaller weight
+                continue;
+            }
+            const size_t arcs_end = graph_->ArcsEnd(vertex);
+            for (size_t arc = graph_->ArcsBegin(vertex); arc < arcs_end; ++arc) {
+                const VertexId target = graph_->GetTarget(arc);
+                const Weight candidate_weight = weight + graph_->GetWeight(arc);
+                if (candidate_weight < tree->weights[target]) {
+                    tree->weights[target] = candidate_weight;
+                    tree->prev_edges[target] = static_cast<Index>(graph_->GetEdgeId(arc));
+                    heap.push_back({candidate_weight, target});
+                    std::push_heap(heap.begin(), heap.end(), cmp);
+                }
+            }
+        }
+        return tree;
+    }
+
+    template <typename Weight>
+    std::shared_ptr<const typename SptCacheRouter<Weight>::Tree> SptCacheRouter<Weight>::GetTree(VertexId from) const {
+        if (from >= graph_->GetVertexCount()) {
+            throw std::out_of_range("Vertex is out of graph");
+        }
+        {
+            std::lock_guard guard(mutex_);
+            if (auto it = cache_.find(from); it != cache_.end()) {
+                ++stats_.hits;
+                lru_.splice(lru_.begin(), lru_, it->second.lru_position);
+                return it->second.tree;
+            }
+            ++stats_.misses;
+        }
+
+        // The tree is computed outside of the lock, so queries from other sources aren't blocked.
+        // Two threads may compute the same tree at once, then the second one is dropped.
+        auto tree = ComputeTree(from);
+
+        std::lock_guard guard(mutex_);
+        if (cache_.count(from) > 0) {
+            return tree;
+        }
+        if (cache_.size() >= capacity_) {
+            cache_.erase(lru_.back());
+            lru_.pop_back();
+            ++stats_.evictions;
+        }
+        lru_.push_front(from);
+        cache_.emplace(from, CacheEntry{tree, lru_.begin()});
+        stats_.cached_trees = cache_.size();
+        return tree;
+    }
+
+    template <typename Weight>
+    std::optional<typename SptCacheRouter<Weight>::RouteInfo> SptCacheRouter<Weight>::BuildRoute(VertexId from,
+                                                                                                 VertexId to) const {
+        if (to >= graph_->GetVertexCount()) {
+            throw std::out_of_range("Vertex is out of graph");
+        }
+        const auto tree = GetTree(from);
+        if (tree->weights[to] == UNREACHABLE) {
+            return std::nullopt;
+        }
+
+        std::vector<EdgeId> edges;
+        for (Index edge_id = tree->prev_edges[to]; edge_id != NO_EDGE; edge_id = tree->prev_edges[edge_sources_[edge_id]]) {
+            edges.push_back(edge_id);
+        }
+        std::reverse(edges.begin(), edges.end());
+
+        return RouteInfo{tree->weights[to], std::move(edges)};
+    }
+
+    template <typename Weight>
+    std::vector<std::optional<Weight>> SptCacheRouter<Weight>::ComputeRouteWeights(
+        VertexId from, const std::vector<VertexId>& targets) const {
+        for (const VertexId to : targets) {
+            if (to >= graph_->GetVertexCount()) {
+                throw std::out_of_range("Vertex is out of graph");
+            }
+        }
+        const auto tree = GetTree(from);
+        std::vector<std::optional<Weight>> weights;
+        weights.reserve(targets.size());
+        for (const VertexId to : targets) {
+            weights.push_back(tree->weights[to] == UNREACHABLE ? std::nullopt : std::optional<Weight>(tree->weights[to]));
+        }
+        return weights;
+    }
+
+    template <typename Weight>
+    typename SptCacheRouter<Weight>::CacheStats SptCacheRouter<Weight>::GetCacheStats() const {
+        std::lock_guard guard(mutex_);
+        return stats_;
+    }
+
+    template <typename Weight>
+    void SptCacheRouter<Weight>::PrintStats(std::ostream& output) const {
+        const CacheStats stats = GetCacheStats();
+        output << "SPT cache: " << stats.hits << " hits, " << stats.misses << " misses, "
+               << stats.evictions << " evictions, " << stats.cached_trees << " of " << stats.capacity
+               << " trees cached" << std::endl;
+    }
+
+}  // namespace graph
@@ -1,102 +1,631 @@
 #include "tests.h"
 
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
 #include <vector>
 #include <sstream>
 
+#include "astar_router.h"
+#include "bidirectional_dijkstra_router.h"
+#include "contraction_hierarchy.h"
+#include "dijkstra_router.h"
 #include "geo.h"
 #include "graph.h"
 // #include "input_reader.h"
+#include "json_builder.h"
 #include "json_reader.h"
+#include "router.h"
+#include "router_storage.h"
+#include "spt_cache_router.h"
 #include "transport_catalogue.h"
 
 namespace tests {
     using namespace transport_catalogue;
 
+    // Names of the bus' stops along the whole route
+    std::vector<std::string_view> BusStopNames(const TransportCatalogue& tc, std::string_view bus_name) {
+        std::vector<std::string_view> names;
+        for (StopId stop : tc.GetBusStops(tc.BusByName(bus_name))) {
+            names.push_back(tc.GetStopName(stop));
+        }
+        return names;
+    }
+
+    // The same pseudo-random sequence on every platform, so the router tests run on the same graphs
+    unsigned NextRandom(unsigned& seed) {
+        seed = seed * 1103515245 + 12345;
+        return (seed >> 16) & 0x7fff;
+    }
+
+    // Edges between random vertices with weights from 0 to 9.9, loops and parallel edges included
+    graph::DirectedWeightedGraph<double> MakeRandomGraph(unsigned seed, size_t vertex_count, size_t edge_count) {
+        graph::DirectedWeightedGraph<double> directed_graph(vertex_count);
+        for (size_t i = 0; i < edge_count; ++i) {
+            const graph::VertexId from = NextRandom(seed) % vertex_count;
+            const graph::VertexId to = NextRandom(seed) % vertex_count;
+            directed_graph.AddEdge({from, to, (NextRandom(seed) % 100) / 10.});
+        }
+        return directed_graph;
+    }
+
+    // A cycle 0 -> 1 -> 2 -> 3 -> 0 with a slower shortcut 0 -> 2, vertex 4 is isolated
+    graph::DirectedWeightedGraph<double> MakeSmallGraph() {
+        graph::DirectedWeightedGraph<double> directed_graph(5);
+        directed_graph.AddEdge({0, 1, 1.});
+        directed_graph.AddEdge({1, 2, 1.});
+        directed_graph.AddEdge({0, 2, 3.});
+        directed_graph.AddEdge({2, 3, 0.5});
+        directed_graph.AddEdge({3, 0, 2.});
+        return directed_graph;
+    }
+
+    // Routes between all pairs of vertices are found by both routers or by neither, have the same weight,
+    // and the edges of the router's route form a path from -> to of that weight
+    void AssertRoutesMatch(const graph::RouterInterface<double>& reference, const graph::RouterInterface<double>& router,
+                           const graph::DirectedWeightedGraph<double>& directed_graph) {
+        for (graph::VertexId from = 0; from < directed_graph.GetVertexCount(); ++from) {
+            for (graph::VertexId to = 0; to < directed_graph.GetVertexCount(); ++to) {
+                auto expected = reference.BuildRoute(from, to);
+                auto route = router.BuildRoute(from, to);
+                ASSERT_EQUAL(expected.has_value(), route.has_value());
+                if (!route) {
+                    continue;
+                }
+                ASSERT_APPOX_EQUAL(route->weight, expected->weight);
+                double weight = 0;
+                graph::VertexId vertex = from;
+                for (auto edge_id : route->edges) {
+                    const auto& edge = directed_graph.GetEdge(edge_id);
+                    ASSERT_EQUAL(edge.from, vertex);
+                    vertex = edge.to;
+                    weight += edge.weight;
+                }
+                ASSERT_EQUAL(vertex, to);
+                ASSERT_APPOX_EQUAL(weight, expected->weight);
+            }
+        }
+    }
+
     void TCAddStop() {
         TransportCatalogue tc;
-        ASSERT(tc.GetStops().empty());
-        ASSERT(tc.GetStopnames().empty());
-        std::string stop_name = "Test1";
-        Stop s {stop_name, 12.2, 76.8, 0};
-        tc.AddStop(s);
-        ASSERT_EQUAL(tc.GetStops().size(), 1);
-        ASSERT_EQUAL(tc.GetStops()[0].name, "Test1");
-        ASSERT_EQUAL(tc.GetStopnames()["Test1"]->name, "Test1");
+        ASSERT_EQUAL(tc.GetStopCount(), size_t{0});
+        const StopId stop = tc.AddStop("Test1", {12.2, 76.8});
+        ASSERT_EQUAL(stop, StopId{0});
+        ASSERT_EQUAL(tc.GetStopCount(), 1u);
+        ASSERT_EQUAL(tc.GetStopName(0), "Test1");
+        ASSERT_EQUAL(tc.FindStop("Test1"), stop);
+        ASSERT_EQUAL(tc.StopByVertex(TransportCatalogue::GetOutVertex(stop)), stop);
+        ASSERT_EQUAL(tc.StopByVertex(2), NO_STOP);
+
+        // The name index grows as stops are added and keeps finding the earlier ones
+        for (int i = 0; i < 100; ++i) {
+            tc.AddStop("Stop" + std::to_string(i), {12.2, 76.8});
+        }
+        ASSERT_EQUAL(tc.FindStop("Test1"), stop);
+        ASSERT_EQUAL(tc.FindStop("Stop99"), 100u);
+        ASSERT_EQUAL(tc.FindStop("Stop100"), NO_STOP);
+        ASSERT_EQUAL(tc.FindBus("Test1"), NO_BUS);
+        try {
+            tc.StopByName("Stop100");
+            ASSERT(false);
+        } catch (const std::out_of_range&) {
+        }
     }
 
     void TCAddBus() {
         TransportCatalogue tc;
-        ASSERT(tc.GetBuses().empty());
-        ASSERT(tc.GetBusnames().empty());
-        std::string stop_name1 = "Test1";
-        std::string stop_name2 = "Test2";
-        Stop s1 {stop_name1, 12.2, 76.8, 0};
-        Stop s2 {stop_name2, 14.2, 77.2, 2};
-        tc.AddStop(s1);
-        tc.AddStop(s2);
-        std::string bus_name = "Bus1";
-        std::vector<Stop*> stops {tc.StopByName("Test1"), tc.StopByName("Test2")};
+        ASSERT_EQUAL(tc.GetBusCount(), 0u);
+        tc.AddStop("Test1", {12.2, 76.8});
+        tc.AddStop("Test2", {14.2, 77.2});
+        tc.AddStop("Test3", {14.3, 77.3});
+        const std::vector<StopId> stops {tc.StopByName("Test1"), tc.StopByName("Test2")};
         tc.AddDistance(tc.StopByName("Test1"), tc.StopByName("Test2"), 25);
-        Bus b {bus_name, stops, tc.GetDists(), true, tc.StopByName("Test1"), tc.StopByName("Test2")};
-        tc.AddBus(b);
-        ASSERT_EQUAL(tc.GetBuses().size(), 1);
-        ASSERT_EQUAL(tc.GetBuses()[0].name, "Bus1");
-        ASSERT_EQUAL(tc.GetBusnames()["Bus1"]->name, "Bus1");
-        ASSERT_EQUAL(tc.GetBusnames()["Bus1"]->stops[0]->name, "Test1");
-        ASSERT_EQUAL(tc.GetBusnames()["Bus1"]->stops[1]->name, "Test2");
-        ASSERT_EQUAL(tc.GetBusnames()["Bus1"]->first->name, "Test1");
-        ASSERT_EQUAL(tc.GetBusnames()["Bus1"]->last->name, "Test2");
-        ASSERT(tc.GetBusnames()["Bus1"]->is_roundtrip);
+        tc.AddDistance(tc.StopByName("Test2"), tc.StopByName("Test3"), 30);
+        tc.AddDistance(tc.StopByName("Test3"), tc.StopByName("Test2"), 35);
+        tc.IndexDistances();
+        const BusId bus = tc.AddBus("Bus1", stops, true);
+        ASSERT_EQUAL(tc.GetBusCount(), 1u);
+        ASSERT_EQUAL(tc.GetBusName(bus), "Bus1");
+        ASSERT_EQUAL(tc.FindBus("Bus1"), bus);
+        ASSERT(BusStopNames(tc, "Bus1") == std::vector<std::string_view>({"Test1", "Test2"}));
+        ASSERT_EQUAL(tc.GetBusFirstStop(bus), tc.StopByName("Test1"));
+        ASSERT_EQUAL(tc.GetBusLastStop(bus), tc.StopByName("Test2"));
+        ASSERT(tc.IsRoundtrip(bus));
+        ASSERT_APPOX_EQUAL(tc.GetBusRouteLength(bus), 25.);
+
+        // The way back is added, its stops aren't counted twice and a distance may be given one way only
+        const BusId two_way = tc.AddBus("Bus2", {tc.StopByName("Test1"), tc.StopByName("Test2"), tc.StopByName("Test3")}, false);
+        ASSERT(BusStopNames(tc, "Bus2") == std::vector<std::string_view>({"Test1", "Test2", "Test3", "Test2", "Test1"}));
+        ASSERT_EQUAL(tc.GetBusStopCount(two_way), 5u);
+        ASSERT_EQUAL(tc.GetBusUniqueStopCount(two_way), 3u);
+        ASSERT_EQUAL(tc.GetBusLastStop(two_way), tc.StopByName("Test3"));
+        ASSERT(!tc.IsRoundtrip(two_way));
+        ASSERT_APPOX_EQUAL(tc.GetBusRouteLength(two_way), 25. + 30. + 35. + 25.);
+        // Buses of stops are indexed once all buses are added, ordered by name rather than by id
+        const BusId first_by_name = tc.AddBus("A", {tc.StopByName("Test3"), tc.StopByName("Test2")}, true);
+        try {
+            tc.GetBusesByStop(tc.StopByName("Test3"));
+            ASSERT(false);
+        } catch (const std::logic_error&) {
+        }
+        tc.IndexBusesByStop();
+        const auto stop_buses = [&tc](std::string_view stop_name) {
+            const auto buses = tc.GetBusesByStop(tc.StopByName(stop_name));
+            return std::vector<BusId>(buses.begin(), buses.end());
+        };
+        ASSERT(stop_buses("Test2") == std::vector<BusId>({first_by_name, bus, two_way}));
+        ASSERT(stop_buses("Test3") == std::vector<BusId>({first_by_name, two_way}));
+
+        // A distance added again replaces the earlier one, and the way back follows it unless it is given
+        tc.AddDistance(tc.StopByName("Test1"), tc.StopByName("Test2"), 40);
+        tc.AddDistance(tc.StopByName("Test2"), tc.StopByName("Test3"), 45);
+        try {
+            tc.GetDistance(tc.StopByName("Test2"), tc.StopByName("Test1"));
+            ASSERT(false);
+        } catch (const std::logic_error&) {
+        }
+        tc.IndexDistances();
+        ASSERT_EQUAL(tc.GetDistance(tc.StopByName("Test2"), tc.StopByName("Test1")), 40);
+        ASSERT_EQUAL(tc.GetDistance(tc.StopByName("Test2"), tc.StopByName("Test3")), 45);
+        ASSERT_EQUAL(tc.GetDistance(tc.StopByName("Test3"), tc.StopByName("Test2")), 35);
+        // The index keeps which distances are given, so they stay when they come back the other way
+        tc.AddDistance(tc.StopByName("Test3"), tc.StopByName("Test1"), 50);
+        tc.AddDistance(tc.StopByName("Test2"), tc.StopByName("Test1"), 55);
+        tc.IndexDistances();
+        ASSERT_EQUAL(tc.GetDistance(tc.StopByName("Test1"), tc.StopByName("Test2")), 40);
+        ASSERT_EQUAL(tc.GetDistance(tc.StopByName("Test2"), tc.StopByName("Test1")), 55);
+        ASSERT_EQUAL(tc.GetDistance(tc.StopByName("Test1"), tc.StopByName("Test3")), 50);
+        ASSERT_EQUAL(tc.GetDistance(tc.StopByName("Test3"), tc.StopByName("Test2")), 35);
+        tc.IndexDistances();
+        ASSERT_EQUAL(tc.GetDistance(tc.StopByName("Test2"), tc.StopByName("Test3")), 45);
+    }
+
+    void JsonLoad() {
+        std::istringstream stream{R"( {"int": -12, "big": 3000000000, "double": 1.5e2, "list": [true, false, null, []],
+            "text": "a\"b\\c\nЖ🚌", "empty": {}} )"};
+        const auto doc = json::Load(stream);
+        const auto& root = doc.GetRoot().AsMap();
+        ASSERT_EQUAL(root.at("int").AsInt(), -12);
+        ASSERT(root.at("big").IsPureDouble());
+        ASSERT_APPOX_EQUAL(root.at("big").AsDouble(), 3e9);
+        ASSERT_APPOX_EQUAL(root.at("double").AsDouble(), 150.);
+        ASSERT(root.at("list") == json::Node(json::Array{true, false, nullptr, json::Array{}}));
+        ASSERT_EQUAL(root.at("text").AsString(), "a\"b\\c\n\xD0\x96\xF0\x9F\x9A\x8C");
+        ASSERT(root.at("empty").AsMap().empty());
+
+        // Strings longer than a vector register
+        const std::string long_text(100, 'x');
+        ASSERT_EQUAL(json::Load("\"" + long_text + "\\t" + long_text + "\"").GetRoot().AsString(), long_text + "\t" + long_text);
+
+        for (const std::string text : {"[1, 2", "{\"a\": 1, \"a\": 2}", "\"line\nbreak\"", "[1 2]", "tru", "[01]", "-", ""}) {
+            try {
+                json::Load(text);
+                ASSERT_HINT(false, text);
+            } catch (const json::ParsingError&) {
+            }
+        }
+    }
+
+    void JsonLoadFile() {
+        const std::string path = (std::filesystem::temp_directory_path() / "tc_json_load_test.json").string();
+        {
+            std::ofstream file(path);
+            file << R"({"plain": "Морской вокзал", "escaped": "a\tb", "list": ["x", 1]})";
+        }
+        const std::string_view key = "plain";
+        {
+            const auto doc = json::LoadFile(path);
+            const auto& root = doc.GetRoot().AsMap();
+            const auto plain = root.find(key);
+            ASSERT(plain != root.end());
+            ASSERT_EQUAL(plain->second.AsString(), "Морской вокзал");
+            ASSERT(std::get<json::String>(plain->second.GetValue()).IsBorrowed());
+            ASSERT_EQUAL(root.at("escaped").AsString(), "a\tb");
+            ASSERT(!std::get<json::String>(root.at("escaped").GetValue()).IsBorrowed());
+            ASSERT(doc.GetRoot() == json::Load(std::string_view(R"({"plain": "Морской вокзал", "escaped": "a\tb", "list": ["x", 1]})")).GetRoot());
+        }
+        std::filesystem::remove(path);
+    }
+
+    void JsonLoadArena() {
+        const std::string text = R"({"stops": ["Морской вокзал", "a\tb", [[], [1, 2.5]]], "empty": "", "map": {"b": null, "a": true}})";
+        const auto heap_doc = json::Load(text);
+        std::istringstream stream(text);
+        const auto arena_doc = json::Load(stream, json::Allocation::ARENA);
+        ASSERT(arena_doc == heap_doc);
+        ASSERT(json::Load(text, json::Allocation::ARENA) == heap_doc);
+        const auto& stops = arena_doc.GetRoot().AsMap().at("stops").AsArray();
+        ASSERT(std::get<json::String>(stops[0].GetValue()).IsBorrowed());
+        ASSERT_EQUAL(stops[1].AsString(), "a\tb");
+
+        // Containers of a copy are allocated on the heap and its strings own their characters,
+        // so the copy outlives the document's arena and text
+        std::istringstream source_stream(text);
+        auto source_doc = std::make_unique<json::Document>(json::Load(source_stream, json::Allocation::ARENA));
+        ASSERT(std::get<json::String>(source_doc->GetRoot().AsMap().at("stops").AsArray()[0].GetValue()).IsBorrowed());
+        json::Node copy = source_doc->GetRoot();
+        source_doc.reset();
+        ASSERT(copy == heap_doc.GetRoot());
+        ASSERT(std::get<json::Dict>(copy.GetValue()).get_allocator().resource() == std::pmr::get_default_resource());
+        const auto& copied_stop = copy.AsMap().at("stops").AsArray()[0];
+        ASSERT(!std::get<json::String>(copied_stop.GetValue()).IsBorrowed());
+        ASSERT_EQUAL(copied_stop.AsString(), "Морской вокзал");
+    }
+
+    void JsonDict() {
+        json::Dict small{{"b", 2}, {"a", 1}, {"c", 3}, {"a", 4}};
+        ASSERT_EQUAL(small.size(), 3u);
+        ASSERT_EQUAL(small.begin()->first, "a");
+        ASSERT_EQUAL(small.at("a").AsInt(), 1);
+        ASSERT(small.find("d") == small.end());
+        ASSERT(!small.emplace("b", 5).second);
+        small["d"] = 4;
+        ASSERT_EQUAL(std::prev(small.end())->first, "d");
+        try {
+            small.at("e");
+            ASSERT(false);
+        } catch (const std::out_of_range&) {
+        }
+
+        // Large dicts are looked up through the hash index, which has to follow every change
+        std::string text = "{";
+        for (int i = 99; i >= 0; --i) {
+            text += "\"key" + std::to_string(i) + "\": " + std::to_string(i) + (i > 0 ? ", " : "}");
+        }
+        for (const auto allocation : {json::Allocation::HEAP, json::Allocation::ARENA}) {
+            const auto doc = json::Load(text, allocation);
+            const auto& large = doc.GetRoot().AsMap();
+            ASSERT_EQUAL(large.size(), 100u);
+            ASSERT_EQUAL(large.begin()->first, "key0");
+            for (int i = 0; i < 100; ++i) {
+                ASSERT_EQUAL(large.at("key" + std::to_string(i)).AsInt(), i);
+            }
+            ASSERT_EQUAL(large.count("key100"), 0u);
+
+            json::Dict copy = large;
+            copy.emplace("key100", 100);
+            copy["a"] = 0;
+            ASSERT_EQUAL(copy.at("key100").AsInt(), 100);
+            ASSERT_EQUAL(copy.at("key50").AsInt(), 50);
+            json::Dict moved = std::move(copy);
+            ASSERT_EQUAL(moved.at("a").AsInt(), 0);
+            ASSERT_EQUAL(moved.size(), 102u);
+            moved = large;
+            ASSERT(moved == large);
+        }
+
+        // Inserts go into the index in place, in key order and before existing keys
+        json::Dict inserted;
+        for (int i = 0; i < 1000; ++i) {
+            inserted.emplace(json::String("key" + std::to_string(1000 + i)), i);
+            inserted.emplace(json::String("key" + std::to_string(999 - i)), -i);
+        }
+        ASSERT_EQUAL(inserted.size(), 2000u);
+        for (int i = 0; i < 1000; ++i) {
+            ASSERT_EQUAL(inserted.at("key" + std::to_string(1000 + i)).AsInt(), i);
+            ASSERT_EQUAL(inserted.at("key" + std::to_string(999 - i)).AsInt(), -i);
+        }
+        ASSERT(!inserted.emplace("key500", 0).second);
+        ASSERT_EQUAL(inserted.count("key2000"), 0u);
+    }
+
+    void JsonString() {
+        const json::String empty;
+        ASSERT(empty.IsInline());
+        ASSERT_EQUAL(empty.View(), "");
+
+        const json::String short_value("fourteen chars");
+        ASSERT(short_value.IsInline());
+        const std::string long_text = "fifteen chars!!";
+        json::String long_value(long_text);
+        ASSERT(!long_value.IsInline() && !long_value.IsBorrowed());
+        ASSERT_EQUAL(long_value.View(), long_text);
+
+        json::String copy = long_value;
+        ASSERT(copy == long_value);
+        json::String moved = std::move(copy);
+        ASSERT_EQUAL(moved.View(), long_text);
+        moved = short_value;
+        ASSERT(moved.IsInline());
+        ASSERT(moved == short_value);
+        ASSERT(moved != long_value);
+
+        // Short keys are inline, long keys of a heap document are owned.
+        // An arena document read from a stream borrows them
+        const std::string text = "{\"a rather long key\": \"a rather long value\", \"short\": 1}";
+        const auto heap_doc = json::Load(text);
+        const auto& heap_dict = heap_doc.GetRoot().AsMap();
+        ASSERT(!heap_dict.begin()->first.IsBorrowed() && !heap_dict.begin()->first.IsInline());
+        json::Dict built;
+        built["another rather long key"] = 1;
+        ASSERT(!built.begin()->first.IsBorrowed() && !built.begin()->first.IsInline());
+        ASSERT(std::prev(heap_dict.end())->first.IsInline());
+        std::istringstream input(text);
+        const auto arena_doc = json::Load(input, json::Allocation::ARENA);
+        ASSERT(arena_doc.GetRoot().AsMap().begin()->first.IsBorrowed());
+        ASSERT(arena_doc == heap_doc);
+        ASSERT_EQUAL(arena_doc.GetRoot().AsMap().at("short").AsInt(), 1);
+    }
+
+    void JsonArrayPrinter() {
+        const json::Array elements{json::Dict{{"id", 1}, {"items", json::Array{1.5, "x"}}}, nullptr, json::Array{}};
+        for (size_t count = 0; count <= elements.size(); ++count) {
+            const json::Array array(elements.begin(), elements.begin() + static_cast<std::ptrdiff_t>(count));
+            std::ostringstream expected;
+            json::Print(json::Document{array}, expected);
+
+            std::ostringstream output;
+            json::ArrayPrinter printer(output);
+            for (const auto& element : array) {
+                printer.Print(element);
+            }
+            printer.Finish();
+            ASSERT_EQUAL(output.str(), expected.str());
+        }
+    }
+
+    void JsonPrint() {
+        const json::Document doc{json::Dict{
+            {"time", 0.1 + 0.2},
+            {"items", json::Array{1, -2.5e-7, "a\"b\\c\nd", true, nullptr, json::Array{}}},
+            {"empty", json::Dict{}}
+        }};
+        auto print = [&doc](const json::PrintSettings& settings) {
+            std::ostringstream output;
+            json::Print(doc, output, settings);
+            return output.str();
+        };
+
+        // Doubles are printed the way streams print them unless asked otherwise
+        for (const double value : {0.1 + 0.2, -2.5e-7, 5950., 1e21}) {
+            std::ostringstream expected;
+            expected << value;
+            std::ostringstream output;
+            json::Print(json::Document{value}, output);
+            ASSERT_EQUAL(output.str(), expected.str());
+        }
+        ASSERT(json::Load(print({})) == json::Load(print({true, 6})));
+
+        ASSERT_EQUAL(print({true, 0}), R"({"empty":{},"items":[1,-2.5e-07,"a\"b\\c\nd",true,null,[]],"time":0.30000000000000004})");
+        ASSERT(json::Load(print({false, 0})) == doc);
+    }
+
+    void JsonBuilderWriter() {
+        // Keys are written in the order they come, here the order of a built dict
+        auto build = [](json::Builder& builder) {
+            builder.StartArray()
+                .StartDict()
+                    .Key("buses").StartArray().Value("14").Value("24").EndArray()
+                    .Key("empty").StartDict().EndDict()
+                    .Key("request_id").Value(1)
+                .EndDict()
+                .Value(0.5)
+                .StartArray().EndArray()
+                .EndArray();
+        };
+        for (const bool compact : {false, true}) {
+            json::Builder node_builder;
+            build(node_builder);
+            std::ostringstream expected;
+            json::Print(json::Document{node_builder.Build()}, expected, {compact});
+
+            std::ostringstream output;
+            json::Writer writer(output, {compact});
+            json::Builder builder(writer);
+            build(builder);
+            writer.Flush();
+            ASSERT_EQUAL(output.str(), expected.str());
+
+            // Items written by a writer nested at their depth come out as if written in place,
+            // both the first items of a container and the ones after other items
+            auto write_first_items = [](json::Writer& writer) {
+                writer.Key("buses");
+                writer.StartArray();
+                writer.Value(json::String("14"));
+                writer.EndArray();
+            };
+            auto write_items = [](json::Writer& writer) {
+                writer.Key("empty");
+                writer.StartDict();
+                writer.EndDict();
+            };
+            std::ostringstream first_items;
+            json::Writer nested_first(first_items, {compact}, 1);
+            nested_first.StartDict();
+            nested_first.Flush();
+            first_items.str({});
+            write_first_items(nested_first);
+            nested_first.Flush();
+            std::ostringstream items;
+            json::Writer nested(items, {compact}, 2);
+            write_items(nested);
+            nested.Flush();
+
+            std::ostringstream written;
+            std::ostringstream spliced;
+            json::Writer writing(written, {compact});
+            json::Writer splicing(spliced, {compact});
+            for (auto* answer : {&writing, &splicing}) {
+                answer->StartArray();
+                answer->StartDict();
+            }
+            write_first_items(writing);
+            splicing.Splice(first_items.str());
+            for (auto* answer : {&writing, &splicing}) {
+                answer->Key("request_id");
+                if (answer == &splicing) {
+                    try {
+                        answer->Splice(items.str());
+                        ASSERT(false);
+                    } catch (const std::logic_error&) {
+                    }
+                }
+                answer->Value(1);
+            }
+            write_items(writing);
+            splicing.Splice(items.str());
+            for (auto* answer : {&writing, &splicing}) {
+                answer->EndDict();
+                answer->EndArray();
+                answer->Flush();
+            }
+            ASSERT_EQUAL(spliced.str(), written.str());
+        }
+
+        std::ostringstream output;
+        json::Writer writer(output);
+        auto expect_error = [&writer](auto call) {
+            json::Builder builder(writer);
+            try {
+                call(builder);
+                ASSERT(false);
+            } catch (const std::logic_error&) {
+            }
+        };
+        // Contexts don't catch these wrong calls, since they are made on the builder itself
+        expect_error([](json::Builder& builder) {
+            builder.StartDict();
+            builder.Key("a");
+            builder.Key("b");
+        });
+        expect_error([](json::Builder& builder) {
+            builder.StartDict();
+            builder.Value(1);
+        });
+        expect_error([](json::Builder& builder) {
+            builder.StartDict();
+            builder.EndArray();
+        });
+        expect_error([](json::Builder& builder) {
+            builder.StartArray();
+            builder.EndDict();
+        });
+        expect_error([](json::Builder& builder) {
+            builder.Value(1);
+            builder.Value(2);
+        });
+        expect_error([](json::Builder& builder) {
+            builder.Key("a");
+        });
+        expect_error([](json::Builder& builder) {
+            builder.Value(1);
+            builder.Build();
+        });
+    }
+
+    void JsonReader() {
+        // Long enough for a stream to be read through several windows, values cross their borders
+        const int count = 3000;
+        std::string text = "[\n";
+        for (int i = 0; i < count; ++i) {
+            text += i == 0 ? "" : ",\n";
+            text += R"(    {"name": "stop \")" + std::to_string(i) + R"(\" \u0416", "id": )" + std::to_string(i)
+                + R"(, "skip": {"a": [1, {"b": "]}"}]}, "position": [1.5, -2e3], "flag": true, "none": null})";
+        }
+        text += "\n]";
+
+        std::istringstream stream(text);
+        json::Reader reader(stream);
+        ASSERT(reader.PeekType() == json::Reader::ValueType::ARRAY);
+        reader.StartArray();
+        int read_count = 0;
+        while (reader.NextElement()) {
+            reader.StartDict();
+            while (const auto key = reader.NextKey()) {
+                if (*key == "name") {
+                    ASSERT_EQUAL(reader.ReadString(), "stop \"" + std::to_string(read_count) + "\" Ж");
+                } else if (*key == "id") {
+                    ASSERT_EQUAL(reader.ReadInt(), read_count);
+                } else if (*key == "position") {
+                    reader.StartArray();
+                    ASSERT(reader.NextElement());
+                    ASSERT_APPOX_EQUAL(reader.ReadDouble(), 1.5);
+                    ASSERT(reader.NextElement());
+                    ASSERT_APPOX_EQUAL(reader.ReadDouble(), -2000.);
+                    ASSERT(!reader.NextElement());
+                } else if (*key == "flag") {
+                    ASSERT(reader.ReadBool());
+                } else if (*key == "none") {
+                    reader.ReadNull();
+                } else {
+                    ASSERT_EQUAL(*key, "skip");
+                    reader.SkipValue();
+                }
+            }
+            ++read_count;
+        }
+        ASSERT_EQUAL(read_count, count);
+
+        std::istringstream whole_stream(text);
+        ASSERT(json::Reader(whole_stream).ReadValue() == json::Load(text).GetRoot());
+        ASSERT(json::Reader(std::string_view(text)).ReadValue() == json::Load(text).GetRoot());
+
+        json::Reader wrong_type(std::string_view(R"(["a"])"));
+        wrong_type.StartArray();
+        ASSERT(wrong_type.NextElement());
+        try {
+            wrong_type.ReadInt();
+            ASSERT(false);
+        } catch (const std::logic_error&) {
+        }
+        json::Reader no_comma(std::string_view("[1 2]"));
+        no_comma.StartArray();
+        ASSERT(no_comma.NextElement());
+        ASSERT_EQUAL(no_comma.ReadInt(), 1);
+        try {
+            no_comma.NextElement();
+            ASSERT(false);
+        } catch (const json::ParsingError&) {
+        }
     }
 
     void InputAddStop() {
         TransportCatalogue tc;
-        ASSERT(tc.GetStops().empty());
-        ASSERT(tc.GetStopnames().empty());
+        ASSERT_EQUAL(tc.GetStopCount(), 0u);
         std::istringstream stream{R"({"type": "Stop","name": "Ривьерский мост","latitude": 43.587795,"longitude": 39.716901,"road_distances": {"Морской вокзал": 850}})"};
         const auto doc = json::Load(stream);
-        json_reader::AddStop(doc.GetRoot().AsMap(), tc, 0);
-        ASSERT_EQUAL(tc.GetStops().size(), 1);
-        ASSERT_EQUAL(tc.GetStops()[0].name, "Ривьерский мост");
-        ASSERT_EQUAL(tc.GetStopnames()["Ривьерский мост"]->name, "Ривьерский мост");
-        ASSERT_APPOX_EQUAL(tc.GetStopnames()["Ривьерский мост"]->coords.lat, 43.587795);
-        ASSERT_APPOX_EQUAL(tc.GetStopnames()["Ривьерский мост"]->coords.lng, 39.716901);
+        json_reader::AddStop(doc.GetRoot().AsMap(), tc);
+        ASSERT_EQUAL(tc.GetStopCount(), 1u);
+        ASSERT_EQUAL(tc.GetStopName(0), "Ривьерский мост");
+        ASSERT_EQUAL(tc.FindStop("Ривьерский мост"), 0u);
+        ASSERT_APPOX_EQUAL(tc.GetStopCoordinates(0).lat, 43.587795);
+        ASSERT_APPOX_EQUAL(tc.GetStopCoordinates(0).lng, 39.716901);
     }
 
     void InputAddDist() {
         TransportCatalogue tc;
-        ASSERT(tc.GetBuses().empty());
-        ASSERT(tc.GetBusnames().empty());
-        ASSERT(tc.GetDists()->empty());
-        std::string stop_name1 = "Test1";
-        std::string stop_name2 = "Test2";
-        Stop s1 {stop_name1, 12.2, 76.8, 0};
-        Stop s2 {stop_name2, 14.2, 77.2, 2};
-        tc.AddStop(s1);
-        tc.AddStop(s2);
+        ASSERT_EQUAL(tc.GetBusCount(), 0u);
+        tc.AddStop("Test1", {12.2, 76.8});
+        tc.AddStop("Test2", {14.2, 77.2});
+        tc.IndexDistances();
+        try {
+            tc.GetDistance(0, 1);
+            ASSERT(false);
+        } catch (const std::out_of_range&) {
+        }
 
         std::istringstream stream{R"({"type": "Stop","name": "Test1","latitude": 43.587795,"longitude": 39.716901,"road_distances": {"Test2": 850}})"};
         const auto doc = json::Load(stream);
         graph::DirectedWeightedGraph<double> directed_graph(4);
         json_reader::RoutingSettings rs{6, 40};
         json_reader::AddDist(doc.GetRoot().AsMap(), tc, directed_graph, rs);
+        tc.IndexDistances();
 
-        ASSERT_EQUAL(tc.GetDists()->size(), 1);
-        ASSERT_EQUAL(directed_graph.GetVertexCount(), 4);
-        ASSERT_EQUAL(directed_graph.GetEdgeCount(), 1);
+        ASSERT_EQUAL(tc.GetDistance(0, 1), 850);
+        ASSERT_EQUAL(tc.GetDistance(1, 0), 850);
+        ASSERT_EQUAL(directed_graph.GetVertexCount(), 4u);
+        ASSERT_EQUAL(directed_graph.GetEdgeCount(), 1u);
     }
 
     void InputAddBusOneWay() {
         TransportCatalogue tc;
-        ASSERT(tc.GetBuses().empty());
-        ASSERT(tc.GetBusnames().empty());
-        std::string stop_name1 = "Test1";
-        std::string stop_name2 = "Test2";
-        Stop s1 {stop_name1, 12.201, 76.801, 0};
-        Stop s2 {stop_name2, 12.202, 76.802, 2};
-        tc.AddStop(s1);
-        tc.AddStop(s2);
+        ASSERT_EQUAL(tc.GetBusCount(), 0u);
+        tc.AddStop("Test1", {12.201, 76.801});
+        tc.AddStop("Test2", {12.202, 76.802});
         tc.AddDistance(tc.StopByName("Test1"), tc.StopByName("Test2"), 200);
+        tc.IndexDistances();
 
         json_reader::RoutingSettings rs{6, 40};
         graph::DirectedWeightedGraph<double> directed_graph(4);
@@ -104,31 +633,24 @@ namespace tests {
         const auto doc = json::Load(stream);
         json_reader::AddBus(doc.GetRoot().AsMap(), tc, directed_graph, rs);
 
-        ASSERT_EQUAL(tc.GetBuses().size(), 1);
-        ASSERT_EQUAL(tc.GetBuses()[0].name, "Bus1");
-        ASSERT_EQUAL(tc.GetBusnames()["Bus1"]->name, "Bus1");
-        ASSERT_EQUAL(tc.GetBusnames()["Bus1"]->stops.size(), 3);
-        ASSERT_EQUAL(tc.GetBusnames()["Bus1"]->stops[0]->name, "Test1");
-        ASSERT_EQUAL(tc.GetBusnames()["Bus1"]->stops[1]->name, "Test2");
-        ASSERT_EQUAL(tc.GetBusnames()["Bus1"]->stops[2]->name, "Test1");
-        ASSERT_APPOX_EQUAL(tc.GetBusnames()["Bus1"]->GetCurvature(), 1.28628);
-        ASSERT_EQUAL(tc.GetBusnames()["Bus1"]->first->name, "Test1");
-        ASSERT_EQUAL(tc.GetBusnames()["Bus1"]->last->name, "Test1");
-        ASSERT(tc.GetBusnames()["Bus1"]->is_roundtrip);
-        ASSERT_EQUAL(directed_graph.GetEdgeCount(), 3);
+        ASSERT_EQUAL(tc.GetBusCount(), 1u);
+        const BusId bus = tc.BusByName("Bus1");
+        ASSERT_EQUAL(tc.GetBusName(bus), "Bus1");
+        ASSERT(BusStopNames(tc, "Bus1") == std::vector<std::string_view>({"Test1", "Test2", "Test1"}));
+        ASSERT_APPOX_EQUAL(tc.GetBusRouteLength(bus) / tc.GetBusGeoLength(bus), 1.28628);
+        ASSERT_EQUAL(tc.GetStopName(tc.GetBusFirstStop(bus)), "Test1");
+        ASSERT_EQUAL(tc.GetStopName(tc.GetBusLastStop(bus)), "Test1");
+        ASSERT(tc.IsRoundtrip(bus));
+        ASSERT_EQUAL(directed_graph.GetEdgeCount(), 3u);
     }
 
     void InputAddBusTwoWay() {
         TransportCatalogue tc;
-        ASSERT(tc.GetBuses().empty());
-        ASSERT(tc.GetBusnames().empty());
-        std::string stop_name1 = "Test1";
-        std::string stop_name2 = "Test2";
-        Stop s1 {stop_name1, 12.201, 76.801, 0};
-        Stop s2 {stop_name2, 12.202, 76.802, 2};
-        tc.AddStop(s1);
-        tc.AddStop(s2);
+        ASSERT_EQUAL(tc.GetBusCount(), 0u);
+        tc.AddStop("Test1", {12.201, 76.801});
+        tc.AddStop("Test2", {12.202, 76.802});
         tc.AddDistance(tc.StopByName("Test1"), tc.StopByName("Test2"), 200);
+        tc.IndexDistances();
 
         json_reader::RoutingSettings rs{6, 40};
         graph::DirectedWeightedGraph<double> directed_graph(4);
@@ -136,26 +658,608 @@ namespace tests {
         const auto doc = json::Load(stream);
         json_reader::AddBus(doc.GetRoot().AsMap(), tc, directed_graph, rs);
 
-        ASSERT_EQUAL(tc.GetBuses().size(), 1);
-        ASSERT_EQUAL(tc.GetBuses()[0].name, "Bus1");
-        ASSERT_EQUAL(tc.GetBusnames()["Bus1"]->name, "Bus1");
-        ASSERT_EQUAL(tc.GetBusnames()["Bus1"]->stops.size(), 3);
-        ASSERT_EQUAL(tc.GetBusnames()["Bus1"]->stops[0]->name, "Test1");
-        ASSERT_EQUAL(tc.GetBusnames()["Bus1"]->stops[1]->name, "Test2");
-        ASSERT_EQUAL(tc.GetBusnames()["Bus1"]->stops[2]->name, "Test1");
-        ASSERT_APPOX_EQUAL(tc.GetBusnames()["Bus1"]->GetCurvature(), 1.28628);
-        ASSERT_EQUAL(tc.GetBusnames()["Bus1"]->first->name, "Test1");
-        ASSERT_EQUAL(tc.GetBusnames()["Bus1"]->last->name, "Test2");
-        ASSERT(!tc.GetBusnames()["Bus1"]->is_roundtrip);
-        ASSERT_EQUAL(directed_graph.GetEdgeCount(), 3);
+        ASSERT_EQUAL(tc.GetBusCount(), 1u);
+        const BusId bus = tc.BusByName("Bus1");
+        ASSERT_EQUAL(tc.GetBusName(bus), "Bus1");
+        ASSERT(BusStopNames(tc, "Bus1") == std::vector<std::string_view>({"Test1", "Test2", "Test1"}));
+        ASSERT_APPOX_EQUAL(tc.GetBusRouteLength(bus) / tc.GetBusGeoLength(bus), 1.28628);
+        ASSERT_EQUAL(tc.GetStopName(tc.GetBusFirstStop(bus)), "Test1");
+        ASSERT_EQUAL(tc.GetStopName(tc.GetBusLastStop(bus)), "Test2");
+        ASSERT(!tc.IsRoundtrip(bus));
+        ASSERT_EQUAL(directed_graph.GetEdgeCount(), 3u);
+    }
+
+    void InputAddBusRoutePattern() {
+        TransportCatalogue tc;
+        tc.AddStop("Test1", {12.201, 76.801});
+        tc.AddStop("Test2", {12.202, 76.802});
+        tc.AddDistance(tc.StopByName("Test1"), tc.StopByName("Test2"), 200);
+        tc.IndexDistances();
+
+        json_reader::RoutingSettings rs{6, 40, json_reader::RouterType::DIJKSTRA, json_reader::GraphModel::ROUTE_PATTERN};
+        graph::DirectedWeightedGraph<double> directed_graph(4);
+        directed_graph.AddEdge({0, 1, 6.});
+        directed_graph.AddEdge({2, 3, 6.});
+        std::istringstream stream{R"({"type": "Bus","name": "Bus1","stops":["Test1", "Test2"],"is_roundtrip": false})"};
+        const auto doc = json::Load(stream);
+        json_reader::AddBus(doc.GetRoot().AsMap(), tc, directed_graph, rs);
+
+        // A vertex per stop position and boarding, riding and alighting edges instead of all stop pairs
+        ASSERT_EQUAL(directed_graph.GetVertexCount(), 7u);
+        ASSERT_EQUAL(directed_graph.GetEdgeCount(), 8u);
+        graph::DijkstraRouter<double> router(directed_graph);
+        auto route = router.BuildRoute(0, 2);
+        ASSERT(route.has_value());
+        ASSERT_APPOX_EQUAL(route->weight, 11.);
+        size_t bus_edge_count = 0;
+        for (graph::EdgeId edge_id = 0; edge_id < directed_graph.GetEdgeCount(); ++edge_id) {
+            bus_edge_count += tc.GetEdgeSpanToBus(edge_id).first != NO_BUS ? 1 : 0;
+        }
+        ASSERT_EQUAL(bus_edge_count, 6u);
+        ASSERT_EQUAL(tc.GetEdgeSpanToBus(0).first, NO_BUS);
+
+        // Route patterns are routed by search unless a router is chosen, and never with all-pairs tables
+        const auto settings = json_reader::ProcessRouting(
+            json::Load(R"({"bus_wait_time": 6, "bus_velocity": 40, "graph_model": "route_pattern"})").GetRoot());
+        ASSERT(settings.router_type == json_reader::RouterType::DIJKSTRA);
+        bool rejected = false;
+        try {
+            json_reader::ProcessRouting(json::Load(R"({"bus_wait_time": 6, "bus_velocity": 40,
+                "graph_model": "route_pattern", "router": "floyd_warshall"})").GetRoot());
+        } catch (const std::invalid_argument&) {
+            rejected = true;
+        }
+        ASSERT(rejected);
+    }
+
+    void InputRoutingSettings() {
+        // Limits of the routers can't be negative
+        const auto limits = json_reader::ProcessRouting(json::Load(R"({"bus_wait_time": 6, "bus_velocity": 40,
+            "landmark_count": 0, "spt_cache_megabytes": 16})").GetRoot());
+        ASSERT_EQUAL(limits.landmark_count, 0u);
+        ASSERT_EQUAL(limits.spt_cache_megabytes, 16u);
+        for (const std::string key : {"landmark_count", "spt_cache_megabytes"}) {
+            try {
+                json_reader::ProcessRouting(json::Load(R"({"bus_wait_time": 6, "bus_velocity": 40, ")" + key + R"(": -1})").GetRoot());
+                ASSERT(false);
+            } catch (const std::invalid_argument&) {
+            }
+        }
+    }
+
+    void InputBaseRequestLoader() {
+        // Keys in any order, a bus before its stops and a distance to a stop which comes later.
+        // Stops and distances of a request of another type are dropped
+        const std::string requests = R"([
+            {"stops": ["Test1", "Test2"], "name": "Bus1", "type": "Bus", "is_roundtrip": false},
+            {"road_distances": {"Depot": 10}, "stops": ["Depot"], "name": "Depot", "type": "Depot"},
+            {"type": "Stop", "name": "Test1", "latitude": 12.201, "longitude": 76.801, "road_distances": {"Test2": 200}},
+            {"road_distances": {}, "longitude": 76.802, "latitude": 12.202, "name": "Test2", "type": "Stop"}
+        ])";
+        json_reader::RoutingSettings rs{6, 40};
+
+        TransportCatalogue dom_tc;
+        const auto dom_graph = json_reader::ProcessBaseRequests(json::Load(requests).GetRoot(), dom_tc, rs);
+
+        TransportCatalogue tc;
+        json_reader::BaseRequestLoader loader(tc);
+        json::Reader reader(std::string_view{requests});
+        loader.Load(reader);
+        ASSERT_EQUAL(tc.GetStopCount(), 2u);
+        ASSERT_EQUAL(tc.GetBusCount(), 0u);
+        loader.Finish();
+        const auto graph = json_reader::BuildGraph(tc, rs);
+
+        const BusId bus = tc.BusByName("Bus1");
+        ASSERT_EQUAL(tc.StopByName("Test2"), 1u);
+        ASSERT_EQUAL(tc.GetBusStopCount(bus), 3u);
+        ASSERT_EQUAL(tc.GetStopName(tc.GetBusLastStop(bus)), "Test2");
+        ASSERT_APPOX_EQUAL(tc.GetBusRouteLength(bus) / tc.GetBusGeoLength(bus), 1.28628);
+        ASSERT_EQUAL(graph.GetVertexCount(), dom_graph.GetVertexCount());
+        ASSERT_EQUAL(graph.GetEdgeCount(), dom_graph.GetEdgeCount());
+        for (graph::EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+            ASSERT_EQUAL(graph.GetEdge(edge_id).from, dom_graph.GetEdge(edge_id).from);
+            ASSERT_EQUAL(graph.GetEdge(edge_id).to, dom_graph.GetEdge(edge_id).to);
+            ASSERT_APPOX_EQUAL(graph.GetEdge(edge_id).weight, dom_graph.GetEdge(edge_id).weight);
+        }
+    }
+
+    // Serves the input in small chunks and remembers how much output there was when each one was asked for
+    class ChunkedInput : public std::streambuf {
+    public:
+        ChunkedInput(std::string input, const std::ostringstream& output)
+            : input_(std::move(input))
+            , output_(output) {
+        }
+
+        const std::vector<size_t>& GetOutputSizes() const {
+            return output_sizes_;
+        }
+
+    protected:
+        int_type underflow() override {
+            if (served_ == input_.size()) {
+                return traits_type::eof();
+            }
+            const size_t size = std::min(CHUNK_SIZE, input_.size() - served_);
+            char* chunk = input_.data() + served_;
+            setg(chunk, chunk, chunk + size);
+            served_ += size;
+            output_sizes_.push_back(output_.str().size());
+            return traits_type::to_int_type(*chunk);
+        }
+
+    private:
+        static constexpr size_t CHUNK_SIZE = 1024;
+
+        std::string input_;
+        size_t served_ = 0;
+        const std::ostringstream& output_;
+        std::vector<size_t> output_sizes_;
+    };
+
+    // Render and routing settings as items of the input dict
+    std::string TestSettings() {
+        return R"("render_settings": {"bus_label_font_size": 20, "bus_label_offset": [7, 15],
+            "color_palette": ["green", [255, 160, 0], "red"], "height": 200, "line_width": 14, "padding": 30,
+            "stop_label_font_size": 20, "stop_label_offset": [7, -3], "stop_radius": 5,
+            "underlayer_color": [255, 255, 255, 0.85], "underlayer_width": 3, "width": 200},
+            "routing_settings": {"bus_velocity": 40, "bus_wait_time": 6})";
+    }
+
+    void InputStatRequestsStreaming() {
+        const std::string settings = TestSettings();
+        const std::string base_requests = R"("base_requests": [
+            {"type": "Bus", "name": "Bus1", "stops": ["Test1", "Test2"], "is_roundtrip": false},
+            {"type": "Stop", "name": "Test1", "latitude": 12.201, "longitude": 76.801, "road_distances": {"Test2": 200}},
+            {"type": "Stop", "name": "Test2", "latitude": 12.202, "longitude": 76.802, "road_distances": {}}])";
+        // Far more requests than the reader takes into memory at once
+        std::string stat_requests = R"("stat_requests": [)";
+        for (int i = 0; i < 3000; ++i) {
+            stat_requests += std::string(i == 0 ? "" : ", ") + R"({"id": )" + std::to_string(i)
+                + (i % 2 == 0 ? R"(, "type": "Bus", "name": "Bus1"})" : R"(, "type": "Stop", "name": "Test1"})");
+        }
+        stat_requests += "]";
+
+        auto process = [](const std::string& input, std::vector<size_t>* output_sizes) {
+            std::ostringstream output;
+            ChunkedInput chunked_input(input, output);
+            std::istream stream(&chunked_input);
+            TransportCatalogue tc;
+            json_reader::ProcessInput(stream, output, tc);
+            if (output_sizes != nullptr) {
+                *output_sizes = chunked_input.GetOutputSizes();
+            }
+            return output.str();
+        };
+
+        // Stat requests after everything they need are answered before the rest of them is read
+        const std::string input = "{" + settings + ", " + base_requests + ", " + stat_requests + "}";
+        std::vector<size_t> output_sizes;
+        const std::string streamed = process(input, &output_sizes);
+        ASSERT(output_sizes.size() > 1);
+        ASSERT(output_sizes.back() > 0);
+        ASSERT(output_sizes.back() < streamed.size());
+        // Keys of the answers are sorted, as json::Print prints them
+        std::ostringstream printed;
+        json::Print(json::Load(streamed), printed);
+        ASSERT_EQUAL(printed.str(), streamed);
+
+        // Those which come first wait for the rest of the input and get the same answers
+        std::vector<size_t> waiting_output_sizes;
+        const std::string waited = process("{" + stat_requests + ", " + base_requests + ", " + settings + "}", &waiting_output_sizes);
+        ASSERT_EQUAL(waiting_output_sizes.back(), 0u);
+        ASSERT_EQUAL(waited, streamed);
+
+        std::ostringstream dom_output;
+        TransportCatalogue dom_tc;
+        json_reader::ProcessDocument(json::Load(input), dom_output, dom_tc);
+        ASSERT_EQUAL(dom_output.str(), streamed);
+    }
+
+    void StatMatrixRequest() {
+        const std::string base_requests = R"("base_requests": [
+            {"type": "Bus", "name": "14", "stops": ["A", "B", "C"], "is_roundtrip": false},
+            {"type": "Bus", "name": "24", "stops": ["C", "D", "C"], "is_roundtrip": true},
+            {"type": "Stop", "name": "A", "latitude": 43.58, "longitude": 39.71, "road_distances": {"B": 1200}},
+            {"type": "Stop", "name": "B", "latitude": 43.59, "longitude": 39.72, "road_distances": {"C": 2500}},
+            {"type": "Stop", "name": "C", "latitude": 43.60, "longitude": 39.73, "road_distances": {"D": 900}},
+            {"type": "Stop", "name": "D", "latitude": 43.61, "longitude": 39.74, "road_distances": {"C": 1100}},
+            {"type": "Stop", "name": "Lonely", "latitude": 43.62, "longitude": 39.75, "road_distances": {}}])";
+        const std::vector<std::string> stops {"A", "B", "C", "D", "Lonely"};
+        // More origins than a thread takes, so a large matrix may be split between threads
+        std::vector<std::string> from;
+        for (int i = 0; i < 4; ++i) {
+            from.insert(from.end(), stops.begin(), stops.end());
+        }
+        auto names = [](const std::vector<std::string>& stop_names) {
+            std::string text = "[";
+            for (const auto& name : stop_names) {
+                text += (text.size() > 1 ? ", \"" : "\"") + name + "\"";
+            }
+            return text + "]";
+        };
+
+        int id = 0;
+        std::string stat_requests = R"("stat_requests": [)";
+        auto add_request = [&stat_requests, &id](const std::string& fields) {
+            stat_requests += (id == 0 ? "{\"id\": " : ", {\"id\": ") + std::to_string(id) + ", " + fields + "}";
+            ++id;
+        };
+        add_request(R"("type": "Matrix", "from": )" + names(from) + R"(, "to": )" + names(stops));
+        add_request(R"("type": "Matrix", "from": ["A", "Nowhere"], "to": ["B"])");
+        add_request(R"("type": "Matrix", "from": [], "to": ["B"])");
+        add_request(R"("type": "Matrix", "from": ["A", "B"], "to": [])");
+        for (const auto& from_stop : stops) {
+            for (const auto& to_stop : stops) {
+                add_request(R"("type": "Route", "from": ")" + from_stop + R"(", "to": ")" + to_stop + "\"");
+            }
+        }
+        stat_requests += "]";
+
+        std::ostringstream output;
+        TransportCatalogue tc;
+        json_reader::ProcessDocument(json::Load("{" + TestSettings() + ", " + base_requests + ", " + stat_requests + "}"), output, tc);
+        const auto answers_doc = json::Load(output.str());
+        const auto& answers = answers_doc.GetRoot().AsArray();
+        ASSERT_EQUAL(answers.size(), 4 + stops.size() * stops.size());
+
+        // Rows follow the origins and columns the destinations, null for unreachable pairs,
+        // every time is the total time of the route between the stops
+        const auto& total_times = answers[0].AsMap().at("total_times").AsArray();
+        ASSERT_EQUAL(total_times.size(), from.size());
+        for (size_t row = 0; row < from.size(); ++row) {
+            const auto& times = total_times[row].AsArray();
+            ASSERT_EQUAL(times.size(), stops.size());
+            for (size_t column = 0; column < stops.size(); ++column) {
+                const auto& route = answers[4 + (row % stops.size()) * stops.size() + column].AsMap();
+                if (times[column].IsNull()) {
+                    ASSERT_EQUAL(route.at("error_message").AsString(), "not found");
+                } else {
+                    ASSERT_APPOX_EQUAL(times[column].AsDouble(), route.at("total_time").AsDouble());
+                }
+            }
+        }
+        ASSERT(total_times[0].AsArray()[4].IsNull());
+        ASSERT(!total_times[0].AsArray()[3].IsNull());
+        ASSERT_APPOX_EQUAL(total_times[2].AsArray()[2].AsDouble(), 0.);
+
+        ASSERT_EQUAL(answers[1].AsMap().at("error_message").AsString(), "not found");
+        ASSERT_EQUAL(answers[1].AsMap().at("request_id").AsInt(), 1);
+        ASSERT(answers[2].AsMap().at("total_times").AsArray().empty());
+        const auto& no_columns = answers[3].AsMap().at("total_times").AsArray();
+        ASSERT_EQUAL(no_columns.size(), 2u);
+        ASSERT(no_columns[0].AsArray().empty() && no_columns[1].AsArray().empty());
+    }
+
+    void StatResponseFragments() {
+        const auto base_doc = json::Load(std::string_view(R"([
+            {"type": "Bus", "name": "14", "stops": ["A", "B"], "is_roundtrip": false},
+            {"type": "Bus", "name": "Bus with a rather long name", "stops": ["B", "A", "B"], "is_roundtrip": true},
+            {"type": "Stop", "name": "A", "latitude": 43.58, "longitude": 39.71, "road_distances": {"B": 1200}},
+            {"type": "Stop", "name": "B", "latitude": 43.59, "longitude": 39.72, "road_distances": {"A": 1300}},
+            {"type": "Stop", "name": "Stop without buses", "latitude": 43.60, "longitude": 39.73, "road_distances": {}}])"));
+        const auto render_doc = json::Load("{" + TestSettings() + "}");
+        TransportCatalogue tc;
+        json_reader::RoutingSettings rs{6, 40};
+        const auto directed_graph = json_reader::ProcessBaseRequests(base_doc.GetRoot(), tc, rs);
+        tc.IndexBusesByStop();
+        const auto map_settings = json_reader::ProcessRender(render_doc.GetRoot().AsMap().at("render_settings"));
+        const map_renderer::MapRenderer renderer(map_settings);
+        const graph::Router<double> router(directed_graph);
+        request_handler::RequestHandler handler(tc, renderer, directed_graph, router);
+
+        // Worth building once the Bus and Stop requests are as many as buses and stops
+        ASSERT(!json_reader::ResponseFragments::IsWorthBuilding(4, tc));
+        ASSERT(json_reader::ResponseFragments::IsWorthBuilding(5, tc));
+
+        const std::vector<std::pair<std::string, std::string>> requests {
+            {"Bus", "14"}, {"Bus", "Bus with a rather long name"}, {"Bus", "A"},
+            {"Stop", "A"}, {"Stop", "B"}, {"Stop", "Stop without buses"}, {"Stop", "14"},
+        };
+        for (const bool compact : {false, true}) {
+            const json::PrintSettings settings{compact};
+            const json_reader::ResponseFragments fragments(tc, handler, settings);
+            for (const auto& [type, name] : requests) {
+                const json::Node request(json::Dict{
+                    {"id", 7}, {"type", json::String(type)}, {"name", json::String(name)},
+                });
+                const auto fragment = fragments.Find(request.AsMap());
+                const bool is_known = type == "Bus" ? tc.FindBus(name) != NO_BUS : tc.FindStop(name) != NO_STOP;
+                ASSERT_EQUAL(fragment.has_value(), is_known);
+                if (!fragment) {
+                    continue;
+                }
+
+                // Answers are written after another one, as in the array of all answers
+                std::ostringstream built;
+                json::Writer building(built, settings);
+                building.StartArray();
+                building.Value(0);
+                json::Builder builder(building);
+                json_reader::ProcessStatRequest(request, builder, handler);
+                building.EndArray();
+                building.Flush();
+
+                std::ostringstream spliced;
+                json::Writer splicing(spliced, settings);
+                splicing.StartArray();
+                splicing.Value(0);
+                splicing.StartDict();
+                splicing.Splice(fragment->before_request_id);
+                splicing.Key("request_id");
+                splicing.Value(7);
+                splicing.Splice(fragment->after_request_id);
+                splicing.EndDict();
+                splicing.EndArray();
+                splicing.Flush();
+                ASSERT_EQUAL(spliced.str(), built.str());
+            }
+            const json::Node route(json::Dict{{"id", 8}, {"type", json::String("Route")}, {"from", json::String("A")}});
+            ASSERT(!fragments.Find(route.AsMap()));
+        }
+    }
+
+    void GraphCompact() {
+        graph::DirectedWeightedGraph<double> directed_graph(4);
+        directed_graph.AddEdge({2, 1, 1.5});
+        directed_graph.AddEdge({0, 3, 2.});
+        directed_graph.AddEdge({2, 0, 0.5});
+        graph::CompactGraph<double> compact_graph(directed_graph);
+        ASSERT_EQUAL(compact_graph.GetVertexCount(), 4u);
+        ASSERT_EQUAL(compact_graph.GetArcCount(), 3u);
+        ASSERT_EQUAL(compact_graph.ArcsEnd(0) - compact_graph.ArcsBegin(0), 1u);
+        ASSERT_EQUAL(compact_graph.ArcsBegin(1), compact_graph.ArcsEnd(1));
+        ASSERT_EQUAL(compact_graph.ArcsEnd(2) - compact_graph.ArcsBegin(2), 2u);
+        const size_t arc = compact_graph.ArcsBegin(2);
+        ASSERT_EQUAL(compact_graph.GetTarget(arc), 1u);
+        ASSERT_APPOX_EQUAL(compact_graph.GetWeight(arc), 1.5);
+        ASSERT_EQUAL(compact_graph.GetEdgeId(arc), 0u);
+        ASSERT_EQUAL(compact_graph.GetEdgeId(arc + 1), 2u);
+
+        // A frozen graph hands the same layout to every router and can't be changed any more
+        ASSERT(directed_graph.GetCompactGraph() != directed_graph.GetCompactGraph());
+        directed_graph.Freeze();
+        ASSERT(directed_graph.IsFrozen());
+        ASSERT(directed_graph.GetCompactGraph() == directed_graph.GetCompactGraph());
+        ASSERT_EQUAL(directed_graph.GetVertexCount(), 4u);
+        ASSERT_EQUAL(directed_graph.GetEdge(2).to, 0u);
+        for (auto change : std::vector<std::function<void()>>{
+                 [&directed_graph]() { directed_graph.AddVertex(); },
+                 [&directed_graph]() { directed_graph.AddEdge({1, 2, 1.}); },
+                 [&directed_graph]() { directed_graph.GetIncidentEdges(2); }}) {
+            try {
+                change();
+                ASSERT(false);
+            } catch (const std::logic_error&) {
+            }
+        }
+        ASSERT_EQUAL(directed_graph.GetEdgeCount(), 3u);
+        const graph::Router<double> router(directed_graph);
+        ASSERT_APPOX_EQUAL(router.BuildRoute(2, 3)->weight, 2.5);
+    }
+
+    void GraphCompactReversed() {
+        graph::DirectedWeightedGraph<double> directed_graph(3);
+        directed_graph.AddEdge({0, 2, 1.});
+        const graph::VertexId added = directed_graph.AddVertex();
+        directed_graph.AddEdge({added, 2, 2.});
+        directed_graph.AddEdge({2, added, 3.});
+        const auto reversed = graph::CompactGraph<double>::Reversed(directed_graph);
+        ASSERT_EQUAL(reversed.GetVertexCount(), 4u);
+        ASSERT_EQUAL(reversed.GetArcCount(), 3u);
+        // Arcs of a vertex lead to the sources of its incoming edges in the order of the edges
+        ASSERT_EQUAL(reversed.ArcsEnd(2) - reversed.ArcsBegin(2), 2u);
+        ASSERT_EQUAL(reversed.GetTarget(reversed.ArcsBegin(2)), 0u);
+        ASSERT_EQUAL(reversed.GetEdgeId(reversed.ArcsBegin(2)), 0u);
+        ASSERT_EQUAL(reversed.GetTarget(reversed.ArcsBegin(2) + 1), added);
+        ASSERT_APPOX_EQUAL(reversed.GetWeight(reversed.ArcsBegin(2) + 1), 2.);
+        ASSERT_EQUAL(reversed.ArcsEnd(added) - reversed.ArcsBegin(added), 1u);
+        ASSERT_EQUAL(reversed.GetTarget(reversed.ArcsBegin(added)), 2u);
+        ASSERT_EQUAL(reversed.GetEdgeId(reversed.ArcsBegin(added)), 2u);
+        ASSERT_EQUAL(reversed.ArcsBegin(0), reversed.ArcsEnd(0));
+
+        // The edges are kept by a frozen graph, so it can be reversed too
+        directed_graph.Freeze();
+        ASSERT_EQUAL(graph::CompactGraph<double>::Reversed(directed_graph).GetArcCount(), 3u);
+    }
+
+    void RouterFloydWarshallThreads() {
+        // Several tiles in each direction, so every phase of the tiled algorithm is involved
+        const auto directed_graph = MakeRandomGraph(7, 150, 600);
+        graph::Router<double> single_thread(directed_graph, 1);
+        graph::Router<double> multi_thread(directed_graph, 4);
+        graph::DijkstraRouter<double> dijkstra(directed_graph);
+        AssertRoutesMatch(dijkstra, single_thread, directed_graph);
+        AssertRoutesMatch(dijkstra, multi_thread, directed_graph);
+    }
+
+    void RouterDijkstra() {
+        const auto directed_graph = MakeSmallGraph();
+        graph::Router<double> floyd_warshall(directed_graph);
+        graph::DijkstraRouter<double> dijkstra(directed_graph);
+        AssertRoutesMatch(floyd_warshall, dijkstra, directed_graph);
+        ASSERT_EQUAL(dijkstra.BuildRoute(0, 3)->edges.size(), 3u);
+        ASSERT(!dijkstra.BuildRoute(4, 0));
+
+        const std::vector<graph::VertexId> targets {3, 4, 0, 3};
+        for (graph::VertexId from = 0; from < 5; ++from) {
+            auto expected = floyd_warshall.ComputeRouteWeights(from, targets);
+            auto weights = dijkstra.ComputeRouteWeights(from, targets);
+            ASSERT_EQUAL(weights.size(), targets.size());
+            for (size_t i = 0; i < targets.size(); ++i) {
+                ASSERT_EQUAL(expected[i].has_value(), weights[i].has_value());
+                if (weights[i]) {
+                    ASSERT_APPOX_EQUAL(*weights[i], *expected[i]);
+                }
+            }
+        }
+        ASSERT(!dijkstra.ComputeRouteWeights(0, targets)[1].has_value());
+    }
+
+    void RouterAStar() {
+        const size_t vertex_count = 60;
+        graph::DirectedWeightedGraph<double> directed_graph(vertex_count);
+        unsigned seed = 7;
+        // Vertices lie on a line, edges are mostly slower than the straight distance but some are faster,
+        // so the metric has to be scaled down to stay a lower bound
+        std::vector<double> positions;
+        for (size_t i = 0; i < vertex_count; ++i) {
+            positions.push_back(NextRandom(seed) % 1000);
+        }
+        for (int i = 0; i < 200; ++i) {
+            const graph::VertexId from = NextRandom(seed) % vertex_count;
+            const graph::VertexId to = NextRandom(seed) % vertex_count;
+            const double factor = i % 50 == 0 ? 0.5 : 1. + (NextRandom(seed) % 100) / 100.;
+            directed_graph.AddEdge({from, to, std::fabs(positions[from] - positions[to]) * factor});
+        }
+        auto metric = [&positions](graph::VertexId from, graph::VertexId to) {
+            return std::fabs(positions[from] - positions[to]);
+        };
+        graph::Router<double> floyd_warshall(directed_graph);
+        for (size_t landmark_count : {0, 1, 8}) {
+            for (bool use_metric : {false, true}) {
+                graph::AStarRouter<double> astar(directed_graph, landmark_count,
+                                                 use_metric ? graph::AStarRouter<double>::Metric(metric) : nullptr);
+                ASSERT_EQUAL(astar.GetLandmarkCount(), landmark_count);
+                AssertRoutesMatch(floyd_warshall, astar, directed_graph);
+            }
+        }
+    }
+
+    void RouterBidirectionalDijkstra() {
+        const auto directed_graph = MakeRandomGraph(13, 60, 180);
+        graph::Router<double> floyd_warshall(directed_graph);
+        graph::BidirectionalDijkstraRouter<double> bidirectional(directed_graph);
+        AssertRoutesMatch(floyd_warshall, bidirectional, directed_graph);
+        ASSERT(bidirectional.BuildRoute(7, 7)->edges.empty());
+    }
+
+    void RouterSptCache() {
+        const auto directed_graph = MakeSmallGraph();
+        graph::Router<double> floyd_warshall(directed_graph);
+        // The budget fits two trees of five vertices
+        graph::SptCacheRouter<double> cache(directed_graph, 130);
+        ASSERT_EQUAL(cache.GetCacheStats().capacity, 2u);
+        for (int round = 0; round < 2; ++round) {
+            AssertRoutesMatch(floyd_warshall, cache, directed_graph);
+        }
+        // Every source misses once per round and hits on the following targets
+        auto stats = cache.GetCacheStats();
+        ASSERT_EQUAL(stats.misses, 10u);
+        ASSERT_EQUAL(stats.hits, 40u);
+        ASSERT_EQUAL(stats.evictions, 8u);
+        ASSERT_EQUAL(stats.cached_trees, 2u);
+
+        // Sources 3 and 4 are cached, 0 evicts the least recently used 3
+        cache.BuildRoute(4, 0);
+        cache.BuildRoute(0, 3);
+        stats = cache.GetCacheStats();
+        ASSERT_EQUAL(stats.hits, 41u);
+        ASSERT_EQUAL(stats.misses, 11u);
+        cache.BuildRoute(4, 1);
+        ASSERT_EQUAL(cache.GetCacheStats().hits, 42u);
+        auto weights = cache.ComputeRouteWeights(3, {0, 4});
+        ASSERT_APPOX_EQUAL(*weights[0], 2.);
+        ASSERT(!weights[1]);
+        ASSERT_EQUAL(cache.GetCacheStats().misses, 12u);
+
+        // The stats are printed through the interface the request handler knows the router by
+        std::ostringstream stats_output;
+        static_cast<const graph::RouterInterface<double>&>(cache).PrintStats(stats_output);
+        ASSERT_EQUAL(stats_output.str(), "SPT cache: 42 hits, 12 misses, 10 evictions, 2 of 2 trees cached\n");
+        std::ostringstream no_stats;
+        static_cast<const graph::RouterInterface<double>&>(floyd_warshall).PrintStats(no_stats);
+        ASSERT(no_stats.str().empty());
+    }
+
+    void RouterContractionHierarchy() {
+        const auto directed_graph = MakeRandomGraph(42, 60, 240);
+        graph::Router<double> floyd_warshall(directed_graph);
+        graph::ContractionHierarchy<double> hierarchy(directed_graph);
+        // Unpacked shortcuts have to be paths of the original edges
+        AssertRoutesMatch(floyd_warshall, hierarchy, directed_graph);
+    }
+
+    void RouterStorage() {
+        TransportCatalogue tc;
+        tc.AddStop("Test1", {12.2, 76.8});
+        tc.AddStop("Test2", {14.2, 77.2});
+        graph::DirectedWeightedGraph<double> directed_graph(4);
+        directed_graph.AddEdge({0, 1, 6.});
+        directed_graph.AddEdge({1, 2, 3.});
+        directed_graph.AddEdge({2, 3, 6.});
+        graph::Router<double> router(directed_graph);
+
+        const std::string path = (std::filesystem::temp_directory_path() / "tc_router_storage_test.bin").string();
+        const auto checksum = router_storage::ComputeChecksum(directed_graph, tc);
+        router_storage::SaveRouter(path, checksum, directed_graph, tc, router);
+
+        auto mapped_router = router_storage::LoadRouter(path, checksum, directed_graph);
+        ASSERT(mapped_router != nullptr);
+        for (graph::VertexId from = 0; from < 4; ++from) {
+            for (graph::VertexId to = 0; to < 4; ++to) {
+                auto expected = router.BuildRoute(from, to);
+                auto route = mapped_router->BuildRoute(from, to);
+                ASSERT_EQUAL(expected.has_value(), route.has_value());
+                if (route) {
+                    ASSERT_APPOX_EQUAL(route->weight, expected->weight);
+                    ASSERT(route->edges == expected->edges);
+                }
+            }
+        }
+        mapped_router.reset();
+
+        // Other base data means other checksum, so the file has to be refused
+        directed_graph.AddEdge({3, 0, 1.});
+        const auto new_checksum = router_storage::ComputeChecksum(directed_graph, tc);
+        ASSERT(new_checksum != checksum);
+        ASSERT(router_storage::LoadRouter(path, new_checksum, directed_graph) == nullptr);
+        std::filesystem::remove(path);
+
+        // A file which can't be written leaves nothing behind, and the router is made without it
+        const std::string bad_path = (std::filesystem::temp_directory_path() / "tc_no_such_dir" / "tables.bin").string();
+        ASSERT(!router_storage::SaveRouter(bad_path, new_checksum, directed_graph, tc, router));
+        ASSERT(!std::filesystem::exists(bad_path + ".tmp"));
+        json_reader::RoutingSettings routing_settings{6, 40.};
+        routing_settings.router_tables_file = bad_path;
+        auto unsaved_router = json_reader::MakeRouter(directed_graph, tc, routing_settings);
+        ASSERT(!std::filesystem::exists(bad_path));
+        auto route = unsaved_router->BuildRoute(0, 3);
+        ASSERT(route.has_value());
+        ASSERT_APPOX_EQUAL(route->weight, 15.);
     }
 
     void RunTests() {
         RUN_TEST(TCAddStop);
         RUN_TEST(TCAddBus);
+        RUN_TEST(JsonLoad);
+        RUN_TEST(JsonLoadFile);
+        RUN_TEST(JsonLoadArena);
+        RUN_TEST(JsonDict);
+        RUN_TEST(JsonString);
+        RUN_TEST(JsonArrayPrinter);
+        RUN_TEST(JsonPrint);
+        RUN_TEST(JsonBuilderWriter);
+        RUN_TEST(JsonReader);
         RUN_TEST(InputAddStop);
         RUN_TEST(InputAddDist);
         RUN_TEST(InputAddBusOneWay);
         RUN_TEST(InputAddBusTwoWay);
+        RUN_TEST(InputAddBusRoutePattern);
+        RUN_TEST(InputRoutingSettings);
+        RUN_TEST(InputBaseRequestLoader);
+        RUN_TEST(InputStatRequestsStreaming);
+        RUN_TEST(StatMatrixRequest);
+        RUN_TEST(StatResponseFragments);
+        RUN_TEST(GraphCompact);
+        RUN_TEST(GraphCompactReversed);
+        RUN_TEST(RouterFloydWarshallThreads);
+        RUN_TEST(RouterDijkstra);
+        RUN_TEST(RouterBidirectionalDijkstra);
+        RUN_TEST(RouterSptCache);
+        RUN_TEST(RouterStorage);
+        RUN_TEST(RouterContractionHierarchy);
+        RUN_TEST(RouterAStar);
     }
 }
@@ -80,6 +80,24 @@ namespace tests {
 
     void TCAddBus();
 
+    void JsonLoad();
+
+    void JsonLoadFile();
+
+    void JsonLoadArena();
+
+    void JsonDict();
+
+    void JsonString();
+
+    void JsonArrayPrinter();
+
+    void JsonPrint();
+
+    void JsonBuilderWriter();
+
+    void JsonReader();
+
     void InputAddStop();
 
     void InputAddDist();
@@ -88,6 +106,36 @@ namespace tests {
 
     void InputAddBusTwoWay();
 
+    void InputAddBusRoutePattern();
+
+    void InputRoutingSettings();
+
+    void InputBaseRequestLoader();
+
+    void InputStatRequestsStreaming();
+
+    void StatMatrixRequest();
+
+    void StatResponseFragments();
+
+    void GraphCompact();
+
+    void GraphCompactReversed();
+
+    void RouterFloydWarshallThreads();
+
+    void RouterDijkstra();
+
+    void RouterBidirectionalDijkstra();
+
+    void RouterSptCache();
+
+    void RouterStorage();
+
+    void RouterContractionHierarchy();
+
+    void RouterAStar();
+
     // This is the main testing function
     void RunTests();
 }
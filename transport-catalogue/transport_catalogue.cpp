@@ -1,91 +1,330 @@
 #include "transport_catalogue.h"
 
+#include <algorithm>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <tuple>
 
 // Comment this out because practicum's platform doesn't support custom files.
 // #include "log_duration.h"
 
 namespace transport_catalogue {
-    TransportCatalogue::TransportCatalogue() {}
+    void NameIndex::Add(const std::deque<std::string>& names, uint32_t id) {
+        if (2 * (size_ + 1) > slots_.size()) {
+            Rebuild(names, std::max<size_t>(16, 2 * slots_.size()));
+        }
+        const size_t mask = slots_.size() - 1;
+        size_t slot = std::hash<std::string_view>{}(names[id]) & mask;
+        while (slots_[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+        slots_[slot] = id + 1;
+        ++size_;
+    }
 
-    Stop* TransportCatalogue::AddStop(const Stop& stop) {
-        stops_.push_back(stop);
-        Stop* current_stop = &(stops_[stops_.size() - 1]);
-        stopname_to_stop_[current_stop->name] = current_stop;
-        vertex_to_stop_[current_stop->in_vertex] = current_stop;
-        vertex_to_stop_[current_stop->out_vertex] = current_stop;
-        stop_to_buses_[current_stop] = {};
-        return current_stop;
+    uint32_t NameIndex::Find(const std::deque<std::string>& names, std::string_view name) const {
+        if (slots_.empty()) {
+            return std::numeric_limits<uint32_t>::max();
+        }
+        const size_t mask = slots_.size() - 1;
+        for (size_t slot = std::hash<std::string_view>{}(name) & mask; slots_[slot] != 0; slot = (slot + 1) & mask) {
+            if (names[slots_[slot] - 1] == name) {
+                return slots_[slot] - 1;
+            }
+        }
+        return std::numeric_limits<uint32_t>::max();
     }
 
-    Bus* TransportCatalogue::AddBus(const Bus& bus) {
-        buses_.push_back(bus);
-        Bus* current_bus = &(buses_[buses_.size() - 1]);
-        busname_to_bus_[current_bus->name] = current_bus;
-        for (Stop* s : bus.stops) {
-            stop_to_buses_.at(s).insert(current_bus);
+    void NameIndex::Rebuild(const std::deque<std::string>& names, size_t slot_count) {
+        std::vector<uint32_t> old_slots(slot_count, 0);
+        slots_.swap(old_slots);
+        const size_t mask = slots_.size() - 1;
+        for (uint32_t entry : old_slots) {
+            if (entry == 0) {
+                continue;
+            }
+            size_t slot = std::hash<std::string_view>{}(names[entry - 1]) & mask;
+            while (slots_[slot] != 0) {
+                slot = (slot + 1) & mask;
+            }
+            slots_[slot] = entry;
         }
-        return current_bus;
     }
 
-    void TransportCatalogue::AddDistance(Stop* s1, Stop* s2, int dist) {
-        dist_between_stops_[{s1, s2}] = dist;
+    TransportCatalogue::TransportCatalogue()
+        : bus_stop_offsets_{0} {
     }
 
-    void TransportCatalogue::AddEdgeSpanToBus(size_t edge, Bus* bus, int span) {
-        edge_to_bus_and_span_[edge] = {bus, span};
+    StopId TransportCatalogue::AddStop(std::string name, geo::Coordinates coords) {
+        const auto stop = static_cast<StopId>(stop_names_.size());
+        stop_names_.push_back(std::move(name));
+        stop_coords_.push_back(coords);
+        stopname_to_stop_[stop_names_.back()] = stop;
+        stop_index_.Add(stop_names_, stop);
+        distances_indexed_ = false;
+        stop_buses_indexed_ = false;
+        return stop;
     }
 
-    std::deque<Stop> TransportCatalogue::GetStops() const {
-        return stops_;
+    BusId TransportCatalogue::AddBus(std::string name, const std::vector<StopId>& stops, bool is_roundtrip) {
+        if (stops.empty()) {
+            throw std::invalid_argument("Bus has no stops");
+        }
+        const auto bus = static_cast<BusId>(bus_names_.size());
+        const size_t first = bus_stops_.size();
+        bus_stops_.insert(bus_stops_.end(), stops.begin(), stops.end());
+        if (!is_roundtrip) {
+            bus_stops_.insert(bus_stops_.end(), std::next(stops.rbegin()), stops.rend());
+        }
+        bus_stop_offsets_.push_back(static_cast<uint32_t>(bus_stops_.size()));
+
+        // The way back has no stops of its own
+        std::vector<StopId> unique_stops(stops);
+        std::sort(unique_stops.begin(), unique_stops.end());
+        unique_stops.erase(std::unique(unique_stops.begin(), unique_stops.end()), unique_stops.end());
+        bus_unique_stop_counts_.push_back(static_cast<uint32_t>(unique_stops.size()));
+        stop_buses_indexed_ = false;
+
+        // We are calculating distances here, because probably input operations will be more frequent, then stat operations.
+        double route_length = 0;
+        double geo_length = 0;
+        for (size_t i = first; i + 1 < bus_stops_.size(); ++i) {
+            route_length += GetDistance(bus_stops_[i], bus_stops_[i + 1]);
+            geo_length += geo::ComputeDistance(stop_coords_[bus_stops_[i]], stop_coords_[bus_stops_[i + 1]]);
+        }
+        bus_route_lengths_.push_back(route_length);
+        bus_geo_lengths_.push_back(geo_length);
+        bus_is_roundtrip_.push_back(is_roundtrip);
+
+        bus_names_.push_back(std::move(name));
+        busname_to_bus_[bus_names_.back()] = bus;
+        bus_index_.Add(bus_names_, bus);
+        return bus;
     }
 
-    std::deque<Stop>* TransportCatalogue::GetStopsPtr() {
-        return &stops_;
+    void TransportCatalogue::AddDistance(StopId from, StopId to, int dist) {
+        added_distances_.push_back({from, to, dist});
+        distances_indexed_ = false;
     }
 
-    std::map<std::string_view, Stop*> TransportCatalogue::GetStopnames() const {
-        return stopname_to_stop_;
+    int TransportCatalogue::GetDistance(StopId from, StopId to) const {
+        if (!distances_indexed_) {
+            throw std::logic_error("Distances aren't indexed");
+        }
+        const auto begin = distance_targets_.begin() + distance_offsets_[from];
+        const auto end = distance_targets_.begin() + distance_offsets_[from + 1];
+        const auto itr = std::lower_bound(begin, end, to);
+        if (itr == end || *itr != to) {
+            throw std::out_of_range("Distance between the stops is unknown");
+        }
+        return distances_[itr - distance_targets_.begin()];
     }
 
-    const std::map<std::string_view, Stop*>* TransportCatalogue::GetStopnamesPtr() const {
+    void TransportCatalogue::IndexDistances() {
+        struct Entry {
+            StopId from;
+            StopId to;
+            // Added distances take precedence over the ones for the way back, later ones over earlier ones
+            bool is_way_back;
+            uint32_t order;
+            int distance;
+        };
+        std::vector<Entry> entries;
+        entries.reserve(distances_.size() + 2 * added_distances_.size());
+        // Indexed distances come first in the order of additions, so the added ones replace them
+        for (StopId from = 0; from + 1 < distance_offsets_.size(); ++from) {
+            for (size_t i = distance_offsets_[from]; i < distance_offsets_[from + 1]; ++i) {
+                entries.push_back({from, distance_targets_[i], distance_is_way_back_[i], 0, distances_[i]});
+            }
+        }
+        for (size_t i = 0; i < added_distances_.size(); ++i) {
+            const auto& [from, to, distance] = added_distances_[i];
+            entries.push_back({from, to, false, static_cast<uint32_t>(i + 1), distance});
+            entries.push_back({to, from, true, static_cast<uint32_t>(i + 1), distance});
+        }
+        added_distances_.clear();
+        added_distances_.shrink_to_fit();
+        std::sort(entries.begin(), entries.end(), [](const Entry& lhs, const Entry& rhs) {
+            return std::tie(lhs.from, lhs.to, lhs.is_way_back, rhs.order)
+                < std::tie(rhs.from, rhs.to, rhs.is_way_back, lhs.order);
+        });
+
+        distance_offsets_.assign(GetStopCount() + 1, 0);
+        distance_targets_.clear();
+        distances_.clear();
+        distance_is_way_back_.clear();
+        for (size_t i = 0; i < entries.size(); ++i) {
+            if (i > 0 && entries[i].from == entries[i - 1].from && entries[i].to == entries[i - 1].to) {
+                continue;
+            }
+            ++distance_offsets_[entries[i].from + 1];
+            distance_targets_.push_back(entries[i].to);
+            distances_.push_back(entries[i].distance);
+            distance_is_way_back_.push_back(entries[i].is_way_back);
+        }
+        for (size_t stop = 0; stop < GetStopCount(); ++stop) {
+            distance_offsets_[stop + 1] += distance_offsets_[stop];
+        }
+        distance_targets_.shrink_to_fit();
+        distances_.shrink_to_fit();
+        distance_is_way_back_.shrink_to_fit();
+        distances_indexed_ = true;
+    }
+
+    void TransportCatalogue::AddEdgeSpanToBus(size_t edge, BusId bus, int span) {
+        if (edge >= edge_buses_.size()) {
+            edge_buses_.resize(edge + 1, NO_BUS);
+            edge_spans_.resize(edge + 1, 0);
+        }
+        edge_buses_[edge] = bus;
+        edge_spans_[edge] = span;
+    }
+
+    size_t TransportCatalogue::GetStopCount() const {
+        return stop_names_.size();
+    }
+
+    std::string_view TransportCatalogue::GetStopName(StopId stop) const {
+        return stop_names_[stop];
+    }
+
+    geo::Coordinates TransportCatalogue::GetStopCoordinates(StopId stop) const {
+        return stop_coords_[stop];
+    }
+
+    TransportCatalogue::BusRange TransportCatalogue::GetBusesByStop(StopId stop) const {
+        if (!stop_buses_indexed_) {
+            throw std::logic_error("Buses of stops aren't indexed");
+        }
+        return {stop_buses_.begin() + stop_bus_offsets_[stop], stop_buses_.begin() + stop_bus_offsets_[stop + 1]};
+    }
+
+    void TransportCatalogue::IndexBusesByStop() {
+        // Buses are visited in name order, so the buses of every stop come ordered by name.
+        // A stop is taken once per bus, as the bus last visited at the stop is remembered
+        std::vector<BusId> last_bus(GetStopCount(), NO_BUS);
+        stop_bus_offsets_.assign(GetStopCount() + 1, 0);
+        for (const auto& [name, bus] : busname_to_bus_) {
+            for (StopId stop : GetBusStops(bus)) {
+                if (last_bus[stop] != bus) {
+                    last_bus[stop] = bus;
+                    ++stop_bus_offsets_[stop + 1];
+                }
+            }
+        }
+        for (size_t stop = 0; stop < GetStopCount(); ++stop) {
+            stop_bus_offsets_[stop + 1] += stop_bus_offsets_[stop];
+        }
+
+        std::vector<uint32_t> positions(stop_bus_offsets_.begin(), std::prev(stop_bus_offsets_.end()));
+        std::fill(last_bus.begin(), last_bus.end(), NO_BUS);
+        stop_buses_.assign(stop_bus_offsets_.back(), NO_BUS);
+        stop_buses_.shrink_to_fit();
+        for (const auto& [name, bus] : busname_to_bus_) {
+            for (StopId stop : GetBusStops(bus)) {
+                if (last_bus[stop] != bus) {
+                    last_bus[stop] = bus;
+                    stop_buses_[positions[stop]++] = bus;
+                }
+            }
+        }
+        stop_buses_indexed_ = true;
+    }
+
+    const std::map<std::string_view, StopId>* TransportCatalogue::GetStopnamesPtr() const {
         return &stopname_to_stop_;
     }
 
-    Stop* TransportCatalogue::StopByName(const std::string& stop_name) const {
-        return stopname_to_stop_.at(stop_name);
+    StopId TransportCatalogue::FindStop(std::string_view stop_name) const {
+        return stop_index_.Find(stop_names_, stop_name);
+    }
+
+    StopId TransportCatalogue::StopByName(std::string_view stop_name) const {
+        const StopId stop = FindStop(stop_name);
+        if (stop == NO_STOP) {
+            throw std::out_of_range("No such stop");
+        }
+        return stop;
+    }
+
+    size_t TransportCatalogue::GetBusCount() const {
+        return bus_names_.size();
+    }
+
+    std::string_view TransportCatalogue::GetBusName(BusId bus) const {
+        return bus_names_[bus];
+    }
+
+    TransportCatalogue::StopRange TransportCatalogue::GetBusStops(BusId bus) const {
+        return {bus_stops_.begin() + bus_stop_offsets_[bus], bus_stops_.begin() + bus_stop_offsets_[bus + 1]};
+    }
+
+    size_t TransportCatalogue::GetBusStopCount(BusId bus) const {
+        return bus_stop_offsets_[bus + 1] - bus_stop_offsets_[bus];
+    }
+
+    size_t TransportCatalogue::GetBusUniqueStopCount(BusId bus) const {
+        return bus_unique_stop_counts_[bus];
+    }
+
+    bool TransportCatalogue::IsRoundtrip(BusId bus) const {
+        return bus_is_roundtrip_[bus];
     }
 
-    std::deque<Bus> TransportCatalogue::GetBuses() const {
-        return buses_;
+    StopId TransportCatalogue::GetBusFirstStop(BusId bus) const {
+        return bus_stops_[bus_stop_offsets_[bus]];
     }
 
-    std::deque<Bus>* TransportCatalogue::GetBusesPtr() {
-        return &buses_;
+    StopId TransportCatalogue::GetBusLastStop(BusId bus) const {
+        const size_t stop_count = GetBusStopCount(bus);
+        // The way back repeats the way there but its last stop
+        const size_t last = IsRoundtrip(bus) ? stop_count - 1 : (stop_count - 1) / 2;
+        return bus_stops_[bus_stop_offsets_[bus] + last];
     }
 
-    std::map<std::string_view, Bus*> TransportCatalogue::GetBusnames() const {
-        return busname_to_bus_;
+    double TransportCatalogue::GetBusRouteLength(BusId bus) const {
+        return bus_route_lengths_[bus];
     }
 
-    const std::map<std::string_view, Bus*>* TransportCatalogue::GetBusnamesPtr() const {
+    double TransportCatalogue::GetBusGeoLength(BusId bus) const {
+        return bus_geo_lengths_[bus];
+    }
+
+    const std::map<std::string_view, BusId>* TransportCatalogue::GetBusnamesPtr() const {
         return &busname_to_bus_;
     }
 
-    const std::unordered_set<Bus*>* TransportCatalogue::GetBusesByStop(Stop* stop) const {
-        auto iter = stop_to_buses_.find(stop);
-        return iter != stop_to_buses_.end() ? &iter->second : nullptr;
+    BusId TransportCatalogue::FindBus(std::string_view bus_name) const {
+        return bus_index_.Find(bus_names_, bus_name);
+    }
+
+    BusId TransportCatalogue::BusByName(std::string_view bus_name) const {
+        const BusId bus = FindBus(bus_name);
+        if (bus == NO_BUS) {
+            throw std::out_of_range("No such bus");
+        }
+        return bus;
     }
 
-    std::unordered_map<std::pair<Stop*, Stop*>, int, StopPointerPairHasher>* TransportCatalogue::GetDists() {
-        return &dist_between_stops_;
+    size_t TransportCatalogue::GetInVertex(StopId stop) {
+        return 2 * static_cast<size_t>(stop);
     }
 
-    const std::unordered_map<size_t, Stop*>* TransportCatalogue::GetVertexToStops() const {
-        return &vertex_to_stop_;
+    size_t TransportCatalogue::GetOutVertex(StopId stop) {
+        return GetInVertex(stop) + 1;
     }
 
-    const std::unordered_map<size_t, std::pair<Bus*, int>>* TransportCatalogue::GetEdgeSpanToBuses() const {
-        return &edge_to_bus_and_span_;
+    StopId TransportCatalogue::StopByVertex(size_t vertex) const {
+        return vertex < 2 * GetStopCount() ? static_cast<StopId>(vertex / 2) : NO_STOP;
+    }
+
+    std::pair<BusId, int> TransportCatalogue::GetEdgeSpanToBus(size_t edge) const {
+        if (edge >= edge_buses_.size()) {
+            return {NO_BUS, 0};
+        }
+        return {edge_buses_[edge], edge_spans_[edge]};
     }
 }
@@ -1,61 +1,171 @@
 #pragma once
 
+#include <cstdint>
 #include <deque>
 #include <map>
 #include <string>
-#include <unordered_map>
-#include <unordered_set>
+#include <string_view>
 #include <utility>
+#include <vector>
 
 #include "domain.h"
+#include "geo.h"
+#include "ranges.h"
 
 namespace transport_catalogue {
+    // Open addressing table of ids plus one over names kept elsewhere, zero is an empty slot.
+    // At most half of the slots are taken, so probe sequences stay short
+    class NameIndex {
+    public:
+        // names[id] is the name of the id, for the added id and all the ones added before
+        void Add(const std::deque<std::string>& names, uint32_t id);
+
+        // std::numeric_limits<uint32_t>::max() if there is no such name
+        uint32_t Find(const std::deque<std::string>& names, std::string_view name) const;
+
+    private:
+        void Rebuild(const std::deque<std::string>& names, size_t slot_count);
+
+        std::vector<uint32_t> slots_;
+        size_t size_ = 0;
+    };
+
+    // Every field of stops and buses is an array indexed by id. Stops of all buses are kept
+    // one bus after another in a single array, and bus statistics are computed once when
+    // the bus is added
     class TransportCatalogue {
     public:
+        using StopRange = ranges::Range<std::vector<StopId>::const_iterator>;
+        using BusRange = ranges::Range<std::vector<BusId>::const_iterator>;
+
         TransportCatalogue();
 
-        Stop* AddStop(const Stop& stop);
+        StopId AddStop(std::string name, geo::Coordinates coords);
+
+        // The stops are the way there, the way back is added for buses which aren't roundtrip.
+        // Distances between the stops have to be known by then
+        BusId AddBus(std::string name, const std::vector<StopId>& stops, bool is_roundtrip);
+
+        // The distance holds for the way back too, unless that one is added as well
+        void AddDistance(StopId from, StopId to, int dist);
+
+        // Has to be called once the last distance is added, before buses are added
+        // and distances are asked for. Distances added after it are merged into the index
+        // by the next call, as if they were added along with the indexed ones
+        void IndexDistances();
+
+        // Throws std::out_of_range if the distance is known in neither direction and
+        // std::logic_error if stops or distances were added since IndexDistances
+        int GetDistance(StopId from, StopId to) const;
+
+        void AddEdgeSpanToBus(size_t edge, BusId bus, int span);
+
+        size_t GetStopCount() const;
+
+        std::string_view GetStopName(StopId stop) const;
+
+        geo::Coordinates GetStopCoordinates(StopId stop) const;
+
+        // Buses which stop at the stop, each one once and ordered by name.
+        // Throws std::logic_error if stops or buses were added since IndexBusesByStop
+        BusRange GetBusesByStop(StopId stop) const;
+
+        // Has to be called once the last bus is added, before buses of stops are asked for
+        void IndexBusesByStop();
+
+        // Ordered by name
+        const std::map<std::string_view, StopId>* GetStopnamesPtr() const;
+
+        // NO_STOP if there is no such stop
+        StopId FindStop(std::string_view stop_name) const;
+
+        // Throws std::out_of_range if there is no such stop
+        StopId StopByName(std::string_view stop_name) const;
+
+        size_t GetBusCount() const;
 
-        Bus* AddBus(const Bus& bus);
+        std::string_view GetBusName(BusId bus) const;
 
-        void AddDistance(Stop* s1, Stop* s2, int dist);
+        // The whole route, with the way back for buses which aren't roundtrip
+        StopRange GetBusStops(BusId bus) const;
 
-        void AddEdgeSpanToBus(size_t edge, Bus* bus, int span);
+        size_t GetBusStopCount(BusId bus) const;
 
-        std::deque<Stop> GetStops() const;
+        size_t GetBusUniqueStopCount(BusId bus) const;
 
-        std::deque<Stop>* GetStopsPtr();
+        bool IsRoundtrip(BusId bus) const;
 
-        std::map<std::string_view, Stop*> GetStopnames() const;
+        StopId GetBusFirstStop(BusId bus) const;
 
-        const std::map<std::string_view, Stop*>* GetStopnamesPtr() const;
+        // The last stop of the way there
+        StopId GetBusLastStop(BusId bus) const;
 
-        Stop* StopByName(const std::string& stop_name) const;
+        // Road distance along the whole route
+        double GetBusRouteLength(BusId bus) const;
 
-        std::deque<Bus> GetBuses() const;
+        // Geographic distance along the whole route
+        double GetBusGeoLength(BusId bus) const;
 
-        std::deque<Bus>* GetBusesPtr();
+        // Ordered by name
+        const std::map<std::string_view, BusId>* GetBusnamesPtr() const;
 
-        std::map<std::string_view, Bus*> GetBusnames() const;
+        // NO_BUS if there is no such bus
+        BusId FindBus(std::string_view bus_name) const;
 
-        const std::map<std::string_view, Bus*>* GetBusnamesPtr() const;
+        // Throws std::out_of_range if there is no such bus
+        BusId BusByName(std::string_view bus_name) const;
 
-        const std::unordered_set<Bus*>* GetBusesByStop(Stop* stop) const;
+        // Waiting at a stop is the edge from its in vertex to its out vertex
+        static size_t GetInVertex(StopId stop);
 
-        std::unordered_map<std::pair<Stop*, Stop*>, int, StopPointerPairHasher>* GetDists();
+        static size_t GetOutVertex(StopId stop);
 
-        const std::unordered_map<size_t, Stop*>* GetVertexToStops() const;
+        // NO_STOP for vertices which aren't any stop's
+        StopId StopByVertex(size_t vertex) const;
 
-        const std::unordered_map<size_t, std::pair<Bus*, int>>* GetEdgeSpanToBuses() const;
+        // NO_BUS for edges which aren't any bus' edges
+        std::pair<BusId, int> GetEdgeSpanToBus(size_t edge) const;
 
     private:
-        std::deque<Stop> stops_;
-        std::map<std::string_view, Stop*> stopname_to_stop_;
-        std::deque<Bus> buses_;
-        std::map<std::string_view, Bus*> busname_to_bus_;
-        std::unordered_map<Stop*, std::unordered_set<Bus*>> stop_to_buses_;
-        std::unordered_map<std::pair<Stop*, Stop*>, int, StopPointerPairHasher> dist_between_stops_;
-        std::unordered_map<size_t, Stop*> vertex_to_stop_;
-        std::unordered_map<size_t, std::pair<Bus*, int>> edge_to_bus_and_span_;
+        struct AddedDistance {
+            StopId from;
+            StopId to;
+            int distance;
+        };
+
+        // Deques keep the names in place for the name indexes
+        std::deque<std::string> stop_names_;
+        std::vector<geo::Coordinates> stop_coords_;
+        // Buses of a stop are stop_buses_[stop_bus_offsets_[stop], stop_bus_offsets_[stop + 1])
+        bool stop_buses_indexed_ = false;
+        std::vector<uint32_t> stop_bus_offsets_;
+        std::vector<BusId> stop_buses_;
+        std::map<std::string_view, StopId> stopname_to_stop_;
+        NameIndex stop_index_;
+
+        std::deque<std::string> bus_names_;
+        // Stops of a bus are bus_stops_[bus_stop_offsets_[bus], bus_stop_offsets_[bus + 1])
+        std::vector<uint32_t> bus_stop_offsets_;
+        std::vector<StopId> bus_stops_;
+        std::vector<uint32_t> bus_unique_stop_counts_;
+        std::vector<double> bus_route_lengths_;
+        std::vector<double> bus_geo_lengths_;
+        std::vector<bool> bus_is_roundtrip_;
+        std::map<std::string_view, BusId> busname_to_bus_;
+        NameIndex bus_index_;
+
+        // Distances added since the last IndexDistances, released by it
+        std::vector<AddedDistance> added_distances_;
+        // Distances from a stop are distances_[distance_offsets_[stop], distance_offsets_[stop + 1]),
+        // sorted by distance_targets_
+        bool distances_indexed_ = false;
+        std::vector<uint32_t> distance_offsets_;
+        std::vector<StopId> distance_targets_;
+        std::vector<int> distances_;
+        // Whether the distance is taken from the way back, so that an added one replaces it on re-indexing
+        std::vector<bool> distance_is_way_back_;
+        // Indexed by edge id
+        std::vector<BusId> edge_buses_;
+        std::vector<int> edge_spans_;
     };
 }